@@ -8,6 +8,11 @@
 #include "sdkconfig.h"
 #include "driver/rtc_io.h"
 #include "../main/globals.h"
+#include "../main/display.h"
+#include "../main/game_clock.h"
+#include "../main/input.h"
+#include "../main/highscores.h"
+#include "../main/profiler.h"
 
 #define SW            128       // screen width
 #define SH            64        // screen height
@@ -19,6 +24,7 @@
 #define SectionWidth  (SW+1)/3  //width of one pipe section
 #define BirdPos       25        //horizontal bird position
 #define LiftVel       12        //vertical flapping velocity
+#define FrameTime     40        //game loop period in ms
 
 static int rand_num = 0;
 
@@ -51,7 +57,7 @@ void OLEDI2C_printNumI(int num, short int x, short int y, short int un1, short i
 
 void OLEDI2C_update()
 {
-    u8g2_SendBuffer(&u8g2);
+    display_flush();
 }
 
 void Delay(int milliseconds)
@@ -528,6 +534,7 @@ void GameOver_Screen(int score){
   if (score>flappy_bird_highscore){
       flappy_bird_highscore=score;
   }
+  highscores_commit();
 
   tcp=(score%10) ;
   dcp=(score%100)/10 ;
@@ -559,6 +566,9 @@ void run_spyrometry_bird()
   float height;                 // bird height
   float deltaT = 0.3;
   bool PointScored;
+  game_clock loop;
+  input_event event;
+  bool flap;
   u8g2_SetFont(&u8g2, u8g2_font_5x7_tr);
 
 
@@ -575,13 +585,15 @@ void run_spyrometry_bird()
       for(int i = 0; i < (NumOfPipes + 1); i++) pipe[i] = -1;
 
       //check for any button press to start
-      esp_light_sleep_start();
+      input_sleep_until_press();
+      game_clock_start(&loop, "flappy_bird", FrameTime);
 
 
       //game loop
       while(1){
 
           //clear start screen or previous screen
+          PROFILE_BEGIN(PROFILE_DRAW);
           OLEDI2C_clrScr();
 
           //draw bird
@@ -590,11 +602,16 @@ void run_spyrometry_bird()
 
           //draw pipes
           for(int i=0; i < (NumOfPipes+1);i++) Draw_Pipe(section_pos + i * SectionWidth, pipe[i]);
+          PROFILE_FRAME();
+          PROFILE_END(PROFILE_DRAW);
 
           //refresh screen
+          PROFILE_BEGIN(PROFILE_FLUSH);
           OLEDI2C_update();
+          PROFILE_END(PROFILE_FLUSH);
 
           //check for collision
+          PROFILE_BEGIN(PROFILE_UPDATE);
           if(section_pos < 18){
               if(Collision_Check(height,section_pos-(SectionWidth-1)/2+SectionWidth,pipe[1],velocity)) break;
           }
@@ -607,9 +624,18 @@ void run_spyrometry_bird()
               score++;
               PointScored = 1;
           }
+          PROFILE_END(PROFILE_UPDATE);
 
-          //check for button press
-          if (gpio_get_level(UP_BUTTON)){
+          //check for button press, a tap between frames still counts
+          PROFILE_BEGIN(PROFILE_INPUT);
+          flap = input_held(INPUT_UP);
+          while(input_poll(&event)){
+              if(event.pressed && event.button == INPUT_UP) flap = true;
+          }
+          PROFILE_END(PROFILE_INPUT);
+
+          PROFILE_BEGIN(PROFILE_UPDATE);
+          if (flap){
               //if button is pressed lift the bird
               velocity = -LiftVel;
           }
@@ -631,7 +657,11 @@ void run_spyrometry_bird()
               }
               pipe[NumOfPipes] = Random_Number() % 30 + 5;
           }
+          PROFILE_END(PROFILE_UPDATE);
+
+          game_clock_wait(&loop);
       }
+      game_clock_report(&loop);
 
 
       //game over section
@@ -643,9 +673,7 @@ void run_spyrometry_bird()
       OLEDI2C_update();
 
       //check for any button press to start
-      esp_light_sleep_start();
-
-      if(!gpio_get_level(LEFT_BUTTON))
+      if(!(input_sleep_until_press() & INPUT_MASK(INPUT_LEFT)))
         break; //exit game
 
       Delay(1000);
@@ -1,5 +1,6 @@
 #include <driver/gpio.h>
 #include <driver/i2c_master.h>
+#include <assert.h>
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -8,325 +9,686 @@
 #include "sdkconfig.h"
 #include "driver/rtc_io.h"
 #include "../main/globals.h"
-
+#include "../main/display.h"
+#include "../main/game_clock.h"
+#include "../main/input.h"
+#include "../main/highscores.h"
+#include "../main/profiler.h"
+
+//the arena can be made larger than the screen, the view then scrolls to follow the head
+#ifndef MAP_WIDTH
 #define MAP_WIDTH 20
+#endif
+#ifndef MAP_HEIGHT
 #define MAP_HEIGHT 10
+#endif
+#define SNAKE_TICK_MS 50
 
-typedef struct snake_node
-{
-    struct snake_node* next;
-    short int x;
-    short int y;
-    short int next_direction;
-    bool eaten;
-    
-} snake_node;
+//frames drawn per tick while the head and tail slide into their new cells, 4 moves them a pixel
+//a frame (80 fps at the normal speed), 1 turns the sliding off
+#ifndef SNAKE_FRAMES_PER_TICK
+#define SNAKE_FRAMES_PER_TICK 4
+#endif
+
+//speed ramp mode starts slower than a normal game and gets faster than it as apples are eaten
+#define SNAKE_RAMP_START_MS     120
+#define SNAKE_RAMP_MIN_MS       30
+#define SNAKE_RAMP_STEP_MS      10
+#define SNAKE_RAMP_APPLES       3   //apples per speed step
+
+#define SNAKE_TURN_QUEUE 3
+
+//cells the screen shows and how close the head may get to a view edge before it scrolls
+#define SNAKE_VIEW_WIDTH    (MAP_WIDTH < 20 ? MAP_WIDTH : 20)
+#define SNAKE_VIEW_HEIGHT   (MAP_HEIGHT < 10 ? MAP_HEIGHT : 10)
+#define SNAKE_CAMERA_MARGIN 4
 
 typedef enum direction
 {
     LEFT, DOWN, RIGHT, UP
 } direction;
 
-static bool snake_map[MAP_HEIGHT][MAP_WIDTH];
+#define SNAKE_CELLS (MAP_WIDTH * MAP_HEIGHT)
 
-snake_node* snake_init()
+#if SNAKE_CELLS > 8192
+#error "snake segments hold cell indices of at most 13 bits"
+#endif
+
+//one body segment packed into 16 bits: the cell index (y * MAP_WIDTH + x), the direction
+//towards the next (older) segment and whether an apple bulge is passing through it
+typedef uint16_t snake_segment;
+
+#define SNAKE_CELL_MASK        0x1fff
+#define SNAKE_DIRECTION_SHIFT  13
+#define SNAKE_EATEN_BIT        0x8000
+
+#define SNAKE_SEGMENT(cell, next_direction, eaten) \
+    ((snake_segment)((cell) | ((next_direction) << SNAKE_DIRECTION_SHIFT) | ((eaten) ? SNAKE_EATEN_BIT : 0)))
+#define SNAKE_SEGMENT_CELL(segment)       ((segment) & SNAKE_CELL_MASK)
+#define SNAKE_SEGMENT_DIRECTION(segment)  (((segment) >> SNAKE_DIRECTION_SHIFT) & 3)
+#define SNAKE_SEGMENT_EATEN(segment)      (((segment) & SNAKE_EATEN_BIT) != 0)
+#define SNAKE_SEGMENT_X(segment)          (SNAKE_SEGMENT_CELL(segment) % MAP_WIDTH)
+#define SNAKE_SEGMENT_Y(segment)          (SNAKE_SEGMENT_CELL(segment) / MAP_WIDTH)
+
+//the body is a ring buffer of segments, the head is the newest entry and the tail the oldest,
+//so moving is a push at the head and a pop at the tail without touching the heap
+typedef struct snake_body
 {
-    snake_node* snake_segment1 = (snake_node*)malloc(sizeof(snake_node));
-    snake_node* snake_segment2 = (snake_node*)malloc(sizeof(snake_node));
-    snake_node* snake_segment3 = (snake_node*)malloc(sizeof(snake_node));
-    snake_node* snake_segment4 = (snake_node*)malloc(sizeof(snake_node));
-    
-    snake_segment1->x = 12; snake_segment1->y = 5; snake_segment1->eaten = false;
-    snake_segment2->x = 11; snake_segment2->y = 5; snake_segment2->eaten = false;
-    snake_segment3->x = 10; snake_segment3->y = 5; snake_segment3->eaten = false;
-    snake_segment4->x = 9;  snake_segment4->y = 5; snake_segment4->eaten = false;
-
-    snake_segment1->next = snake_segment2; snake_segment1->next_direction = LEFT; 
-    snake_segment2->next = snake_segment3; snake_segment2->next_direction = LEFT;
-    snake_segment3->next = snake_segment4; snake_segment3->next_direction = LEFT;
-    snake_segment4->next = NULL;           snake_segment4->next_direction = LEFT;
-
-    snake_map[5][9] = true;  snake_map[5][10] = true;
-    snake_map[5][11] = true; snake_map[5][12] = true;
-
-    return snake_segment1;
-}
-
-void snake_free_memory(snake_node* snake_head)
-{
-    snake_node* prev = snake_head;
-    while(snake_head)
-    {
-        snake_head = snake_head->next;
-        free(prev);
-        prev = snake_head;
-    }
-}
-
-snake_node* snake_add_segment(snake_node* snake_head, direction snake_direction)
-{
-    snake_node* new_head = (snake_node*)malloc(sizeof(snake_node));
-    new_head->next = snake_head;
-    new_head->x = snake_head->x;
-    new_head->y = snake_head->y;
-    new_head->eaten = false;
-    snake_head = new_head;
-            
-    switch (snake_direction)
-    {
-    case LEFT:
-        snake_head->x--;
-        if(snake_head->x < 0)
-            snake_head->x = MAP_WIDTH - 1;
-        snake_head->next_direction = RIGHT;
-        break;
-    case DOWN:
-        snake_head->y--;
-        if(snake_head->y < 0)
-            snake_head->y = MAP_HEIGHT - 1;
-        snake_head->next_direction = UP;
-        break;
-    case UP:
-        snake_head->y++;
-        if(snake_head->y >= MAP_HEIGHT)
-            snake_head->y = 0;
-        snake_head->next_direction = DOWN;
-        break;
-    case RIGHT:
-        snake_head->x++;
-        if(snake_head->x >= MAP_WIDTH)
-            snake_head->x = 0;
-        snake_head->next_direction = LEFT;
-        break;
-    }
-    snake_map[snake_head->y][snake_head->x] = true;
-    
-    return snake_head;
+    snake_segment segments[SNAKE_CELLS];
+    uint16_t slots[SNAKE_CELLS];    //ring position of the segment on every occupied cell
+    uint16_t head;
+    uint16_t length;
+} snake_body;
+
+#define SNAKE_ROW_WORDS ((MAP_WIDTH + 31) / 32)
+
+//occupancy as one bit per cell plus an unordered list of the free cells, so a random free cell
+//is a single pick and occupying or releasing a cell is a swap with the last entry of the list
+typedef struct snake_board
+{
+    uint32_t rows[MAP_HEIGHT][SNAKE_ROW_WORDS];   //bit x of a row is set when the cell is occupied,
+                                                  //the padding bits past MAP_WIDTH are always set
+    uint16_t free_cells[SNAKE_CELLS];   //the first free_count entries are the free cells
+    uint16_t free_slot[SNAKE_CELLS];    //where a free cell sits in free_cells
+    uint16_t free_count;
+} snake_board;
+
+//a cell together with where its occupancy bit lives, word counts through the rows as one array,
+//so moving and testing a cell needs no division
+typedef uint32_t snake_place;
+
+#define SNAKE_PLACE(cell, word, bit)  ((snake_place)(cell) | ((snake_place)(word) << 13) | ((snake_place)(bit) << 26))
+#define SNAKE_PLACE_CELL(place)       ((place) & SNAKE_CELL_MASK)
+#define SNAKE_PLACE_WORD(place)       (((place) >> 13) & 0x1fff)
+#define SNAKE_PLACE_BIT(place)        ((place) >> 26)
+
+static snake_place snake_neighbors[SNAKE_CELLS][4];   //the wrapped neighbour of every cell in each direction
+
+snake_place snake_place_at(short int x, short int y)
+{
+    return SNAKE_PLACE(y * MAP_WIDTH + x, y * SNAKE_ROW_WORDS + (x >> 5), x & 31);
+}
+
+//builds the neighbour table, once at startup before any game or thread uses it
+void snake_neighbors_init()
+{
+    for(short int y = 0; y < MAP_HEIGHT; y++)
+        for(short int x = 0; x < MAP_WIDTH; x++)
+        {
+            snake_place* neighbors = snake_neighbors[y * MAP_WIDTH + x];
+            neighbors[LEFT] = snake_place_at(x == 0 ? MAP_WIDTH - 1 : x - 1, y);
+            neighbors[DOWN] = snake_place_at(x, y == 0 ? MAP_HEIGHT - 1 : y - 1);
+            neighbors[RIGHT] = snake_place_at(x == MAP_WIDTH - 1 ? 0 : x + 1, y);
+            neighbors[UP] = snake_place_at(x, y == MAP_HEIGHT - 1 ? 0 : y + 1);
+        }
+}
+
+//the neighbour table must have been built with snake_neighbors_init before the first board, an
+//unbuilt one is all zeros and would send every move to cell 0, the left wrap of cell 0 catches it
+void snake_board_clear(snake_board* board)
+{
+    assert(snake_neighbors[0][LEFT] == snake_place_at(MAP_WIDTH - 1, 0));
+    memset(board->rows, 0, sizeof(board->rows));
+    if(MAP_WIDTH % 32)
+        for(short int y = 0; y < MAP_HEIGHT; y++)
+            board->rows[y][SNAKE_ROW_WORDS - 1] = ~0u << (MAP_WIDTH % 32);
+    for(uint16_t cell = 0; cell < SNAKE_CELLS; cell++)
+    {
+        board->free_cells[cell] = cell;
+        board->free_slot[cell] = cell;
+    }
+    board->free_count = SNAKE_CELLS;
+}
+
+bool snake_place_occupied(const snake_board* board, snake_place place)
+{
+    return (((const uint32_t*)board->rows)[SNAKE_PLACE_WORD(place)] >> SNAKE_PLACE_BIT(place)) & 1;
+}
+
+void snake_occupy_place(snake_board* board, snake_place place)
+{
+    if(snake_place_occupied(board, place))
+        return;
+    ((uint32_t*)board->rows)[SNAKE_PLACE_WORD(place)] |= 1u << SNAKE_PLACE_BIT(place);
+
+    uint16_t slot = board->free_slot[SNAKE_PLACE_CELL(place)];
+    uint16_t last = board->free_cells[--board->free_count];
+    board->free_cells[slot] = last;
+    board->free_slot[last] = slot;
+}
+
+void snake_release_place(snake_board* board, snake_place place)
+{
+    if(!snake_place_occupied(board, place))
+        return;
+    ((uint32_t*)board->rows)[SNAKE_PLACE_WORD(place)] &= ~(1u << SNAKE_PLACE_BIT(place));
+
+    uint16_t cell = SNAKE_PLACE_CELL(place);
+    board->free_cells[board->free_count] = cell;
+    board->free_slot[cell] = board->free_count++;
+}
+
+bool snake_cell_occupied(const snake_board* board, short int x, short int y)
+{
+    return snake_place_occupied(board, snake_place_at(x, y));
+}
+
+void snake_occupy_cell(snake_board* board, short int x, short int y)
+{
+    snake_occupy_place(board, snake_place_at(x, y));
+}
+
+void snake_release_cell(snake_board* board, short int x, short int y)
+{
+    snake_release_place(board, snake_place_at(x, y));
+}
+
+void snake_body_clear(snake_body* body)
+{
+    body->head = SNAKE_CELLS - 1;
+    body->length = 0;
+}
+
+//segment i counted from the head, 0 is the head and length - 1 the tail
+snake_segment snake_segment_at(const snake_body* body, uint16_t i)
+{
+    return body->segments[body->head >= i ? body->head - i : body->head + SNAKE_CELLS - i];
+}
+
+snake_segment snake_head(const snake_body* body)
+{
+    return body->segments[body->head];
+}
+
+void snake_push_head(snake_body* body, snake_segment segment)
+{
+    body->head = body->head + 1 == SNAKE_CELLS ? 0 : body->head + 1;
+    body->segments[body->head] = segment;
+    body->slots[SNAKE_SEGMENT_CELL(segment)] = body->head;
+    body->length++;
+}
+
+//index counted from the head of the segment on an occupied cell
+uint16_t snake_segment_on_cell(const snake_body* body, uint16_t cell)
+{
+    uint16_t slot = body->slots[cell];
+    return body->head >= slot ? body->head - slot : body->head + SNAKE_CELLS - slot;
+}
+
+snake_segment snake_pop_tail(snake_body* body)
+{
+    body->length--;
+    return snake_segment_at(body, body->length);
+}
+
+//lays a body out from its head for the menu thumbnails, path holds the next_direction of every
+//segment but the tail as 'L', 'D', 'R' or 'U' and bit i of eaten marks segment i
+void snake_body_trace(snake_body* body, short int head_x, short int head_y, const char* path, uint32_t eaten)
+{
+    static const char letters[] = "LDRU";
+    short int length = strlen(path) + 1;
+    short int x = head_x, y = head_y;
+
+    //walk to the tail first since the ring buffer is filled from the tail
+    for(short int i = 0; i < length - 1; i++)
+    {
+        direction next_direction = strchr(letters, path[i]) - letters;
+        x += (next_direction == RIGHT) - (next_direction == LEFT);
+        y += (next_direction == UP) - (next_direction == DOWN);
+    }
+
+    snake_body_clear(body);
+    for(short int i = length - 1; i >= 0; i--)
+    {
+        direction next_direction = i < length - 1 ? strchr(letters, path[i]) - letters : LEFT;
+        snake_push_head(body, SNAKE_SEGMENT(y * MAP_WIDTH + x, next_direction, (eaten >> i) & 1));
+        if(i > 0)
+        {
+            direction prev_direction = strchr(letters, path[i - 1]) - letters;
+            x -= (prev_direction == RIGHT) - (prev_direction == LEFT);
+            y -= (prev_direction == UP) - (prev_direction == DOWN);
+        }
+    }
+}
+
+//turns pressed faster than the snake moves, one is applied per tick so a quick double turn
+//is not collapsed into its last press
+typedef struct snake_turns
+{
+    uint8_t queued[SNAKE_TURN_QUEUE];
+    uint8_t count;
+} snake_turns;
+
+//queues a turn unless it repeats or reverses the direction the snake will be heading by then
+void snake_turns_push(snake_turns* turns, direction snake_direction, direction turn)
+{
+    direction last = turns->count ? turns->queued[turns->count - 1] : snake_direction;
+    if(turns->count == SNAKE_TURN_QUEUE || turn == last || turn == ((last + 2) & 3))
+        return;
+    turns->queued[turns->count++] = turn;
+}
+
+direction snake_turns_pop(snake_turns* turns, direction snake_direction)
+{
+    if(turns->count == 0)
+        return snake_direction;
+    direction turn = turns->queued[0];
+    turns->count--;
+    memmove(turns->queued, turns->queued + 1, turns->count);
+    return turn;
 }
 
-void snake_pop_last_segment(snake_node* snake_head)
+//everything one game needs, games do not share any state so many can run side by side (the
+//host harness plays thousands across threads), only the neighbour table and the tile atlas are
+//global and both stay read only once built
+typedef struct snake_state
 {
-    snake_node* curr = snake_head;
-    snake_node* prev = snake_head;
-    while(curr->next)
+    snake_board map;
+    snake_body body;
+    snake_turns turns;
+    direction snake_direction;
+    unsigned int seed;      //rand_r state for the apples and animals
+    bool ramp, demo;
+    int score;
+    short int apple_x, apple_y, apples_till_animal, apples_till_ramp, tick_ms;
+    short int animal_timer, animal_id, animal_x, animal_y;
+
+    //what the last step changed, for the renderer
+    snake_segment old_tail;
+    bool tail_moved, redraw, animal_drawn;
+    short int camera_x, camera_y;   //map cell shown in the bottom left corner
+} snake_state;
+
+static snake_state snake_game;
+
+void snake_init(snake_state* game)
+{
+    snake_body_clear(&game->body);
+    for(short int x = MAP_WIDTH / 2 - 1; x <= MAP_WIDTH / 2 + 2; x++)
     {
-        prev = curr;
-        curr = curr->next;
+        snake_push_head(&game->body, SNAKE_SEGMENT(MAP_HEIGHT / 2 * MAP_WIDTH + x, LEFT, false));
+        snake_occupy_cell(&game->map, x, MAP_HEIGHT / 2);
     }
-    snake_map[curr->y][curr->x] = false;
-    free(curr);
-    prev->next = NULL;
 }
 
-bool snake_apple_in_front(snake_node* snake_head, direction snake_direction, short int apple_x, short int apple_y)
+void snake_add_segment(snake_state* game, direction snake_direction)
+{
+    snake_place place = snake_neighbors[SNAKE_SEGMENT_CELL(snake_head(&game->body))][snake_direction];
+    snake_push_head(&game->body, SNAKE_SEGMENT(SNAKE_PLACE_CELL(place), (snake_direction + 2) & 3, false));
+    snake_occupy_place(&game->map, place);
+}
+
+snake_segment snake_pop_last_segment(snake_state* game)
+{
+    snake_segment tail = snake_pop_tail(&game->body);
+    //the new tail still points at the cell it followed
+    snake_segment new_tail = snake_segment_at(&game->body, game->body.length - 1);
+    snake_release_place(&game->map, snake_neighbors[SNAKE_SEGMENT_CELL(new_tail)][SNAKE_SEGMENT_DIRECTION(new_tail)]);
+    return tail;
+}
+
+void snake_mark_eaten(snake_body* body)
 {
-    switch(snake_direction)
+    body->segments[body->head] |= SNAKE_EATEN_BIT;
+}
+
+bool snake_apple_in_front(const snake_body* body, direction snake_direction, short int apple_x, short int apple_y)
+{
+    if(apple_x == -1 || apple_y == -1)
+        return false;
+    uint16_t apple = apple_y * MAP_WIDTH + apple_x;
+    uint16_t ahead = SNAKE_PLACE_CELL(snake_neighbors[SNAKE_SEGMENT_CELL(snake_head(body))][snake_direction]);
+    return ahead == apple || SNAKE_PLACE_CELL(snake_neighbors[ahead][snake_direction]) == apple;
+}
+
+#define SNAKE_X_OFFSET ((DISPLAY_WIDTH - 4*SNAKE_VIEW_WIDTH) / 2 - 1)
+#define SNAKE_Y_OFFSET 4
+
+//every shape a snake cell can show is pre-rendered into a 4x4 tile, one byte per column with
+//bit 0 the top row, so drawing a cell is a lookup and a masked write into the page buffer
+typedef uint8_t snake_tile[4];
+
+static snake_tile snake_body_tiles[4][4][2];   //[link side of the newer segment][next_direction][eaten]
+static snake_tile snake_tail_tiles[4];         //[link side of the newer segment]
+static snake_tile snake_head_tiles[4][5];      //[next_direction][open mouth direction + 1, 0 is closed]
+static const snake_tile snake_empty_tile = {0};
+
+//pixel (lx, ly) of a tile, ly counts upwards like the map
+void snake_tile_pixel(uint8_t* tile, short int lx, short int ly, bool on)
+{
+    if(on)
+        tile[lx] |= 1 << (3 - ly);
+    else
+        tile[lx] &= ~(1 << (3 - ly));
+}
+
+//half of the link between two neighbouring segments, on the given side of the cell
+void snake_tile_connector(uint8_t* tile, direction side)
+{
+    switch(side)
     {
         case LEFT:
-            if(snake_head->y == apple_y &&
-                (((snake_head->x - 1 + MAP_WIDTH) % MAP_WIDTH) == apple_x ||
-                ((snake_head->x - 2 + MAP_WIDTH) % MAP_WIDTH) == apple_x))
-                return true;
-            else
-                return false;
+            snake_tile_pixel(tile, 0, 1, true); snake_tile_pixel(tile, 0, 2, true); break;
         case RIGHT:
-            if(snake_head->y == apple_y &&
-                (((snake_head->x+1) % MAP_WIDTH) == apple_x ||
-                ((snake_head->x+2) % MAP_WIDTH) == apple_x))
-                return true;
-            else
-                return false;
+            snake_tile_pixel(tile, 3, 1, true); snake_tile_pixel(tile, 3, 2, true); break;
         case DOWN:
-            if(snake_head->x == apple_x &&
-                (((snake_head->y - 1 + MAP_HEIGHT) % MAP_HEIGHT) == apple_y ||
-                ((snake_head->y - 2 + MAP_HEIGHT) % MAP_HEIGHT) == apple_y))
-                return true;
-            else
-                return false;
+            snake_tile_pixel(tile, 1, 0, true); snake_tile_pixel(tile, 2, 0, true); break;
         case UP:
-            if(snake_head->x == apple_x &&
-                (((snake_head->y+1) % MAP_HEIGHT) == apple_y ||
-                ((snake_head->y+2) % MAP_HEIGHT) == apple_y))
-                return true;
-            else
-                return false;
-        default:
-            return false;
-    }
-}
-
-void snake_draw_snake(snake_node* snake_head, direction snake_direction)
-{
-    short int x_offset = (DISPLAY_WIDTH - 4*MAP_WIDTH) / 2 - 1;
-    short int y_offset = 4;
-    short int x_pos, y_pos; 
-
-    //draw the middle part
-    snake_node* curr = snake_head->next;
-    direction prev_direction = snake_head->next_direction;
-    while(curr->next)
-    {
-        x_pos = curr->x * 4;
-        y_pos = curr->y * 4;
-
-        bool orientation = true;
-        if(prev_direction == DOWN || prev_direction == RIGHT)
-            orientation = false;
-        if(curr->next_direction != prev_direction && 
-            (curr->next_direction == DOWN || curr->next_direction == RIGHT))
-            orientation = !orientation;
-        if(orientation)
-        {
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-        }
-        else
-        {
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-        }
+            snake_tile_pixel(tile, 1, 3, true); snake_tile_pixel(tile, 2, 3, true); break;
+    }
+}
 
-        if(curr->eaten)
-        {
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 0, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 0, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 3, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 3, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 0));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 0));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 3));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 3));
-        }
+void snake_render_body_tile(uint8_t* tile, direction prev_direction, direction next_direction, bool eaten)
+{
+    snake_tile_connector(tile, (prev_direction + 2) % 4);
+
+    //the diagonal follows the turn the body takes through the cell
+    bool orientation = true;
+    if(prev_direction == DOWN || prev_direction == RIGHT)
+        orientation = false;
+    if(next_direction != prev_direction &&
+        (next_direction == DOWN || next_direction == RIGHT))
+        orientation = !orientation;
+    if(orientation)
+    {
+        snake_tile_pixel(tile, 1, 2, true); snake_tile_pixel(tile, 2, 1, true);
+    }
+    else
+    {
+        snake_tile_pixel(tile, 1, 1, true); snake_tile_pixel(tile, 2, 2, true);
+    }
 
-        switch(curr->next_direction)
-        {
-            case LEFT:
-                x_pos -= 2; break;
-            case RIGHT:
-                x_pos += 2; break;
-            case DOWN:
-                y_pos -= 2; break;
-            case UP:
-                y_pos += 2; break;
-        }
-        u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-            DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-        u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-            DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-        u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-            DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-        u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-            DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-
-        prev_direction = curr->next_direction;
-        curr = curr->next;
-    }
-
-    //draw the tail
-    x_pos = 4 * curr->x;
-    y_pos = 4 * curr->y;
+    if(eaten)
+    {
+        snake_tile_pixel(tile, 0, 1, true); snake_tile_pixel(tile, 0, 2, true);
+        snake_tile_pixel(tile, 3, 1, true); snake_tile_pixel(tile, 3, 2, true);
+        snake_tile_pixel(tile, 1, 0, true); snake_tile_pixel(tile, 2, 0, true);
+        snake_tile_pixel(tile, 1, 3, true); snake_tile_pixel(tile, 2, 3, true);
+    }
+
+    snake_tile_connector(tile, next_direction);
+}
+
+void snake_render_tail_tile(uint8_t* tile, direction prev_direction)
+{
+    snake_tile_connector(tile, (prev_direction + 2) % 4);
     switch(prev_direction)
     {
         case RIGHT:
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 3, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
+            snake_tile_pixel(tile, 1, 1, true); snake_tile_pixel(tile, 2, 1, true);
+            snake_tile_pixel(tile, 1, 2, true); snake_tile_pixel(tile, 3, 1, true);
             break;
         case LEFT:
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 0, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
+            snake_tile_pixel(tile, 1, 1, true); snake_tile_pixel(tile, 2, 1, true);
+            snake_tile_pixel(tile, 2, 2, true); snake_tile_pixel(tile, 0, 1, true);
             break;
         case UP:
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 3));
+            snake_tile_pixel(tile, 1, 1, true); snake_tile_pixel(tile, 2, 1, true);
+            snake_tile_pixel(tile, 2, 2, true); snake_tile_pixel(tile, 2, 3, true);
             break;
         case DOWN:
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-            u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 0));
+            snake_tile_pixel(tile, 1, 2, true); snake_tile_pixel(tile, 2, 1, true);
+            snake_tile_pixel(tile, 2, 2, true); snake_tile_pixel(tile, 2, 0, true);
             break;
     }
+}
 
-    //draw head
-    x_pos = snake_head->x * 4;
-    y_pos = snake_head->y * 4;
-    u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-    u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 1));
-    u8g2_DrawPixel(&u8g2, x_offset + x_pos + 1, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-    u8g2_DrawPixel(&u8g2, x_offset + x_pos + 2, DISPLAY_HEIGHT - (y_offset + y_pos + 2));
-
-    //draw neck and eye
-    switch(snake_head->next_direction)
+//mouth is the direction the open mouth faces or -1 for a closed one
+void snake_render_head_tile(uint8_t* tile, direction next_direction, int mouth)
+{
+    //head, then neck and eye
+    snake_tile_pixel(tile, 1, 1, true); snake_tile_pixel(tile, 2, 1, true);
+    snake_tile_pixel(tile, 1, 2, true); snake_tile_pixel(tile, 2, 2, true);
+    switch(next_direction)
     {
         case RIGHT:
-            x_pos += 2;
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 3 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_SetDrawColor(&u8g2, 0);
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_SetDrawColor(&u8g2, 1);
+            snake_tile_pixel(tile, 3, 1, true); snake_tile_pixel(tile, 3, 3, true);
+            snake_tile_pixel(tile, 3, 2, false);
             break;
         case LEFT:
-            x_pos -= 2;
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 3 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_SetDrawColor(&u8g2, 0);
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_SetDrawColor(&u8g2, 1);
+            snake_tile_pixel(tile, 0, 1, true); snake_tile_pixel(tile, 0, 3, true);
+            snake_tile_pixel(tile, 0, 2, false);
             break;
         case DOWN:
-            y_pos -= 2;
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 0 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_SetDrawColor(&u8g2, 0);
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_SetDrawColor(&u8g2, 1);
+            snake_tile_pixel(tile, 0, 0, true); snake_tile_pixel(tile, 2, 0, true);
+            snake_tile_pixel(tile, 1, 0, false);
             break;
         case UP:
-            y_pos += 2;
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 0 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 2 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 2 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_SetDrawColor(&u8g2, 0);
-            u8g2_DrawPixel(&u8g2, x_offset + (x_pos + 1 + 4 * MAP_WIDTH)  % (4 * MAP_WIDTH),
-                DISPLAY_HEIGHT - (y_offset + (y_pos + 1 + 4 * MAP_HEIGHT) % (4 * MAP_HEIGHT)));
-            u8g2_SetDrawColor(&u8g2, 1);
+            snake_tile_pixel(tile, 0, 3, true); snake_tile_pixel(tile, 2, 3, true);
+            snake_tile_pixel(tile, 1, 3, false);
+            break;
+    }
+
+    switch(mouth)
+    {
+        case LEFT:
+            snake_tile_pixel(tile, 1, 0, true); snake_tile_pixel(tile, 1, 3, true);
+            snake_tile_pixel(tile, 1, 1, false); snake_tile_pixel(tile, 1, 2, false);
+            break;
+        case RIGHT:
+            snake_tile_pixel(tile, 2, 0, true); snake_tile_pixel(tile, 2, 3, true);
+            snake_tile_pixel(tile, 2, 1, false); snake_tile_pixel(tile, 2, 2, false);
+            break;
+        case DOWN:
+            snake_tile_pixel(tile, 0, 1, true); snake_tile_pixel(tile, 3, 1, true);
+            snake_tile_pixel(tile, 1, 1, false); snake_tile_pixel(tile, 2, 1, false);
+            break;
+        case UP:
+            snake_tile_pixel(tile, 0, 2, true); snake_tile_pixel(tile, 3, 2, true);
+            snake_tile_pixel(tile, 1, 2, false); snake_tile_pixel(tile, 2, 2, false);
             break;
     }
 }
 
+//renders the atlas, once at startup next to snake_neighbors_init before anything draws a snake
+void snake_atlas_init()
+{
+    memset(snake_body_tiles, 0, sizeof(snake_body_tiles));
+    memset(snake_tail_tiles, 0, sizeof(snake_tail_tiles));
+    memset(snake_head_tiles, 0, sizeof(snake_head_tiles));
+    for(short int prev = 0; prev < 4; prev++)
+    {
+        for(short int next = 0; next < 4; next++)
+        {
+            snake_render_body_tile(snake_body_tiles[prev][next][0], prev, next, false);
+            snake_render_body_tile(snake_body_tiles[prev][next][1], prev, next, true);
+        }
+        snake_render_tail_tile(snake_tail_tiles[prev], prev);
+    }
+    for(short int next = 0; next < 4; next++)
+        for(short int mouth = -1; mouth < 4; mouth++)
+            snake_render_head_tile(snake_head_tiles[next][mouth + 1], next, mouth);
+}
+
+//where map cell (x, y) is inside the view, false when the camera does not show it
+bool snake_view_cell(const snake_state* game, short int x, short int y, short int* view_x, short int* view_y)
+{
+    *view_x = x - game->camera_x;
+    if(*view_x < 0)
+        *view_x += MAP_WIDTH;
+    *view_y = y - game->camera_y;
+    if(*view_y < 0)
+        *view_y += MAP_HEIGHT;
+    return *view_x < SNAKE_VIEW_WIDTH && *view_y < SNAKE_VIEW_HEIGHT;
+}
+
+//overwrites the 4x4 block whose top left pixel is (left, top), the columns either fit one page
+//byte or spill their last rows into the page below
+void snake_blit_pixels(short int left, short int top, const uint8_t* tile)
+{
+    short int shift = top & 7;
+    uint8_t* column = u8g2_GetBufferPtr(&u8g2) + (top >> 3) * DISPLAY_WIDTH + left;
+    uint16_t mask = 0xf << shift;
+    for(short int i = 0; i < 4; i++)
+    {
+        uint16_t bits = tile[i] << shift;
+        column[i] = (column[i] & ~mask) | bits;
+        if(shift > 4)
+            column[i + DISPLAY_WIDTH] = (column[i + DISPLAY_WIDTH] & ~(mask >> 8)) | (bits >> 8);
+    }
+}
+
+//overwrites the block of view cell (x, y), a cell starts at bit 1 or 5 of a page
+void snake_blit_tile(short int x, short int y, const uint8_t* tile)
+{
+    snake_blit_pixels(SNAKE_X_OFFSET + 4 * x, DISPLAY_HEIGHT - (SNAKE_Y_OFFSET + 4 * y + 3), tile);
+}
+
+//a tile on its way from view cell (x, y) to the neighbour in direction move, pixels of 4 along
+void snake_blit_tile_toward(short int x, short int y, direction move, short int pixels, const uint8_t* tile)
+{
+    snake_blit_pixels(SNAKE_X_OFFSET + 4 * x + ((move == RIGHT) - (move == LEFT)) * pixels,
+        DISPLAY_HEIGHT - (SNAKE_Y_OFFSET + 4 * y + 3) - ((move == UP) - (move == DOWN)) * pixels, tile);
+}
+
+//view cell of map cell (x, y) when it and its neighbour in direction move are both shown side
+//by side, so that something sliding between them stays inside the frame (not across a wrap)
+bool snake_view_slide(const snake_state* game, short int x, short int y, direction move, short int* view_x, short int* view_y)
+{
+    short int next_x, next_y;
+    snake_place next = snake_neighbors[y * MAP_WIDTH + x][move];
+    if(!snake_view_cell(game, x, y, view_x, view_y) ||
+        !snake_view_cell(game, SNAKE_PLACE_CELL(next) % MAP_WIDTH, SNAKE_PLACE_CELL(next) / MAP_WIDTH, &next_x, &next_y))
+        return false;
+    return next_x == *view_x + (move == RIGHT) - (move == LEFT) && next_y == *view_y + (move == UP) - (move == DOWN);
+}
+
+void snake_clear_cell(const snake_state* game, short int x, short int y)
+{
+    short int view_x, view_y;
+    if(snake_view_cell(game, x, y, &view_x, &view_y))
+        snake_blit_tile(view_x, view_y, snake_empty_tile);
+}
+
+//overwrites the cell of segment i with its tile, which holds everything of the snake inside
+//that cell including the links from both neighbours
+void snake_draw_segment(const snake_state* game, uint16_t i)
+{
+    const snake_body* body = &game->body;
+    snake_segment curr = snake_segment_at(body, i);
+    direction next_direction = SNAKE_SEGMENT_DIRECTION(curr);
+    const uint8_t* tile;
+    short int view_x, view_y;
+    if(!snake_view_cell(game, SNAKE_SEGMENT_X(curr), SNAKE_SEGMENT_Y(curr), &view_x, &view_y))
+        return;
+
+    if(i == 0)
+        tile = snake_head_tiles[next_direction][0];
+    else
+    {
+        direction prev_direction = SNAKE_SEGMENT_DIRECTION(snake_segment_at(body, i - 1));
+        if(i == body->length - 1)
+            tile = snake_tail_tiles[prev_direction];
+        else
+            tile = snake_body_tiles[prev_direction][next_direction][SNAKE_SEGMENT_EATEN(curr)];
+    }
+    snake_blit_tile(view_x, view_y, tile);
+}
+
+//patches the cells one move changed, progress counts the pixels of 4 the head and tail have slid
+//out of their previous cells, the last frame of a tick (progress 4) leaves every cell with its
+//own tile, moves that cannot slide inside the view jump straight there
+void snake_draw_motion(const snake_state* game, snake_segment old_tail, bool tail_moved, short int progress,
+    const uint8_t* head_tile)
+{
+    const snake_body* body = &game->body;
+    short int view_x, view_y, next_x, next_y;
+    if(tail_moved)
+        snake_clear_cell(game, SNAKE_SEGMENT_X(old_tail), SNAKE_SEGMENT_Y(old_tail));
+    if(progress >= 4)
+    {
+        snake_draw_segment(game, 0);
+        snake_draw_segment(game, 1);
+        snake_draw_segment(game, body->length - 1);
+        return;
+    }
+
+    //the new tail keeps its body tile until the old tail has slid onto it
+    snake_segment tail = snake_segment_at(body, body->length - 1);
+    direction tail_link = SNAKE_SEGMENT_DIRECTION(tail);
+    direction tail_move = (tail_link + 2) & 3;
+    if(tail_moved && snake_view_slide(game, SNAKE_SEGMENT_X(old_tail), SNAKE_SEGMENT_Y(old_tail), tail_move, &view_x, &view_y))
+    {
+        snake_view_cell(game, SNAKE_SEGMENT_X(tail), SNAKE_SEGMENT_Y(tail), &next_x, &next_y);
+        direction prev_direction = SNAKE_SEGMENT_DIRECTION(snake_segment_at(body, body->length - 2));
+        snake_blit_tile(next_x, next_y, snake_body_tiles[prev_direction][tail_link][SNAKE_SEGMENT_EATEN(tail)]);
+        snake_blit_tile_toward(view_x, view_y, tail_move, progress, snake_tail_tiles[tail_link]);
+    }
+    else
+        snake_draw_segment(game, body->length - 1);
+
+    //the head pushes out of the neck into its new cell
+    snake_segment head = snake_head(body);
+    snake_segment neck = snake_segment_at(body, 1);
+    direction head_move = (SNAKE_SEGMENT_DIRECTION(head) + 2) & 3;
+    snake_draw_segment(game, 1);
+    if(snake_view_slide(game, SNAKE_SEGMENT_X(neck), SNAKE_SEGMENT_Y(neck), head_move, &view_x, &view_y))
+    {
+        snake_clear_cell(game, SNAKE_SEGMENT_X(head), SNAKE_SEGMENT_Y(head));
+        snake_blit_tile_toward(view_x, view_y, head_move, progress, head_tile);
+    }
+    else
+        snake_draw_segment(game, 0);
+}
+
+void snake_draw_snake(const snake_state* game)
+{
+    for(uint16_t i = 0; i < game->body.length; i++)
+        snake_draw_segment(game, i);
+}
+
+//draws the segments inside the view by looking them up per visible cell, so the cost depends
+//on the view size rather than on the snake length
+void snake_draw_view(const snake_state* game)
+{
+    for(short int view_y = 0; view_y < SNAKE_VIEW_HEIGHT; view_y++)
+    {
+        short int y = (game->camera_y + view_y) % MAP_HEIGHT;
+        for(short int view_x = 0; view_x < SNAKE_VIEW_WIDTH; view_x++)
+        {
+            short int x = (game->camera_x + view_x) % MAP_WIDTH;
+            if(snake_cell_occupied(&game->map, x, y))
+                snake_draw_segment(game, snake_segment_on_cell(&game->body, y * MAP_WIDTH + x));
+        }
+    }
+}
+
+//keeps the head at least SNAKE_CAMERA_MARGIN cells away from the view edges on axes where the
+//arena is larger than the view, returns true when the view scrolled
+bool snake_camera_follow(snake_state* game, short int head_x, short int head_y)
+{
+    bool scrolled = false;
+    if(MAP_WIDTH > SNAKE_VIEW_WIDTH)
+    {
+        //signed offset of the head from the view, negative when it is left of the view
+        short int view_x = (head_x - game->camera_x + MAP_WIDTH) % MAP_WIDTH;
+        if(view_x > (MAP_WIDTH + SNAKE_VIEW_WIDTH) / 2)
+            view_x -= MAP_WIDTH;
+        if(view_x < SNAKE_CAMERA_MARGIN)
+            game->camera_x = (head_x - SNAKE_CAMERA_MARGIN + MAP_WIDTH) % MAP_WIDTH, scrolled = true;
+        else if(view_x >= SNAKE_VIEW_WIDTH - SNAKE_CAMERA_MARGIN)
+            game->camera_x = (head_x - (SNAKE_VIEW_WIDTH - 1 - SNAKE_CAMERA_MARGIN) + MAP_WIDTH) % MAP_WIDTH, scrolled = true;
+    }
+    if(MAP_HEIGHT > SNAKE_VIEW_HEIGHT)
+    {
+        short int view_y = (head_y - game->camera_y + MAP_HEIGHT) % MAP_HEIGHT;
+        if(view_y > (MAP_HEIGHT + SNAKE_VIEW_HEIGHT) / 2)
+            view_y -= MAP_HEIGHT;
+        if(view_y < SNAKE_CAMERA_MARGIN)
+            game->camera_y = (head_y - SNAKE_CAMERA_MARGIN + MAP_HEIGHT) % MAP_HEIGHT, scrolled = true;
+        else if(view_y >= SNAKE_VIEW_HEIGHT - SNAKE_CAMERA_MARGIN)
+            game->camera_y = (head_y - (SNAKE_VIEW_HEIGHT - 1 - SNAKE_CAMERA_MARGIN) + MAP_HEIGHT) % MAP_HEIGHT, scrolled = true;
+    }
+    return scrolled;
+}
+
+//centers the view on the head, or pins it to the origin when the arena fits the screen
+void snake_camera_reset(snake_state* game, short int head_x, short int head_y)
+{
+    game->camera_x = MAP_WIDTH > SNAKE_VIEW_WIDTH ? (head_x - SNAKE_VIEW_WIDTH / 2 + MAP_WIDTH) % MAP_WIDTH : 0;
+    game->camera_y = MAP_HEIGHT > SNAKE_VIEW_HEIGHT ? (head_y - SNAKE_VIEW_HEIGHT / 2 + MAP_HEIGHT) % MAP_HEIGHT : 0;
+}
+
 void snake_start_screen()
 {
     u8g2_ClearBuffer(&u8g2);
@@ -341,9 +703,13 @@ void snake_start_screen()
     const char *prompt = "Press any button to play";
     short int prompt_width = u8g2_GetStrWidth(&u8g2, prompt);
     short int prompt_x = (DISPLAY_WIDTH - prompt_width) / 2;
-    u8g2_DrawStr(&u8g2, prompt_x, 60, prompt);
+    u8g2_DrawStr(&u8g2, prompt_x, 52, prompt);
+
+    const char *ramp = "Up for speed ramp";
+    short int ramp_x = (DISPLAY_WIDTH - u8g2_GetStrWidth(&u8g2, ramp)) / 2;
+    u8g2_DrawStr(&u8g2, ramp_x, 61, ramp);
 
-    u8g2_SendBuffer(&u8g2);
+    display_flush();
 }
 
 void snake_end_screen(int score)
@@ -371,37 +737,155 @@ void snake_end_screen(int score)
     u8g2_DrawStr(&u8g2, 5, 60, "Play Again");
     u8g2_DrawStr(&u8g2, 95, 60, "Exit");
 
-    u8g2_SendBuffer(&u8g2);
+    display_flush();
 
     if (score > snake_highscore)
         snake_highscore = score;
+    highscores_commit();
+}
+
+bool snake_collision_check(const snake_state* game, direction snake_direction)
+{
+    return snake_place_occupied(&game->map, snake_neighbors[SNAKE_SEGMENT_CELL(snake_head(&game->body))][snake_direction]);
+}
+
+//---------------------------------------- autopilot ----------------------------------------------
+//plays snake for the attract mode, searches are done on whole rows of cells at once: a set of
+//cells is a bitmap shaped like the occupancy rows and growing it by one step is a few shifts
+typedef uint32_t snake_bitmap[MAP_HEIGHT][SNAKE_ROW_WORDS];
+
+bool snake_bitmap_test(const snake_bitmap set, short int x, short int y)
+{
+    return (set[y][x >> 5] >> (x & 31)) & 1;
+}
+
+//bitmaps share the layout of the occupancy rows, so a place addresses them too
+bool snake_bitmap_test_place(const snake_bitmap set, snake_place place)
+{
+    return (((const uint32_t*)set)[SNAKE_PLACE_WORD(place)] >> SNAKE_PLACE_BIT(place)) & 1;
+}
+
+void snake_bitmap_set_place(snake_bitmap set, snake_place place)
+{
+    ((uint32_t*)set)[SNAKE_PLACE_WORD(place)] |= 1u << SNAKE_PLACE_BIT(place);
 }
 
-bool snake_collision_check(snake_node* snake_head, direction snake_direction)
+//adds the wrapped neighbours of every cell in set that are also in allowed,
+//returns false once the set stopped growing
+bool snake_bitmap_grow(snake_bitmap set, const snake_bitmap allowed)
 {
-    int head_x = snake_head->x;
-    int head_y = snake_head->y;
-    switch(snake_direction)
+    snake_bitmap grown;
+    bool changed = false;
+    for(short int y = 0; y < MAP_HEIGHT; y++)
     {
-        case LEFT:
-            head_x--; break;
-        case RIGHT:
-            head_x++; break;
-        case UP:
-            head_y++; break;
-        case DOWN:
-            head_y--; break;
+        const uint32_t* row = set[y];
+        const uint32_t* above = set[y == MAP_HEIGHT - 1 ? 0 : y + 1];
+        const uint32_t* below = set[y == 0 ? MAP_HEIGHT - 1 : y - 1];
+        for(short int k = 0; k < SNAKE_ROW_WORDS; k++)
+        {
+            uint32_t from_left = (row[k] << 1) | (k > 0 ? row[k - 1] >> 31 : 0);
+            uint32_t from_right = (row[k] >> 1) | (k + 1 < SNAKE_ROW_WORDS ? row[k + 1] << 31 : 0);
+            grown[y][k] = row[k] | from_left | from_right | above[k] | below[k];
+        }
+        //across the side edges
+        if(snake_bitmap_test(set, MAP_WIDTH - 1, y))
+            grown[y][0] |= 1;
+        if(row[0] & 1)
+            grown[y][(MAP_WIDTH - 1) >> 5] |= 1u << ((MAP_WIDTH - 1) & 31);
+
+        for(short int k = 0; k < SNAKE_ROW_WORDS; k++)
+        {
+            grown[y][k] &= allowed[y][k] | row[k];
+            changed |= grown[y][k] != row[k];
+        }
     }
+    memcpy(set, grown, sizeof(grown));
+    return changed;
+}
 
-    return snake_map[head_y % MAP_HEIGHT][head_x % MAP_WIDTH];
+short int snake_bitmap_count(const snake_bitmap set)
+{
+    short int count = 0;
+    for(short int y = 0; y < MAP_HEIGHT; y++)
+        for(short int k = 0; k < SNAKE_ROW_WORDS; k++)
+            count += __builtin_popcount(set[y][k]);
+    return count;
+}
+
+//picks the next direction: the shortest way to the apple as long as the tail stays reachable
+//from where the move leads (so the snake can always follow itself out), otherwise the move
+//into the largest open area, preferring ones that keep the tail reachable
+direction snake_autopilot(const snake_state* game, direction snake_direction)
+{
+    const snake_body* body = &game->body;
+    short int apple_x = game->apple_x, apple_y = game->apple_y;
+    snake_segment tail = snake_segment_at(body, body->length - 1);
+    short int tail_x = SNAKE_SEGMENT_X(tail), tail_y = SNAKE_SEGMENT_Y(tail);
+    const snake_place* neighbors = snake_neighbors[SNAKE_SEGMENT_CELL(snake_head(body))];
+
+    //the tail moves on before anything can reach its cell, so searches may pass through it
+    snake_bitmap open;
+    for(short int y = 0; y < MAP_HEIGHT; y++)
+        for(short int k = 0; k < SNAKE_ROW_WORDS; k++)
+            open[y][k] = ~game->map.rows[y][k];
+    open[tail_y][tail_x >> 5] |= 1u << (tail_x & 31);
+
+    //moves that do not hit the body right away, the current direction first so ties keep going straight
+    direction moves[3];
+    snake_place move_places[3];
+    short int move_count = 0;
+    for(short int turn = 0; turn < 4; turn++)
+    {
+        direction move = (snake_direction + (turn == 3 ? 3 : turn)) % 4;
+        if(turn == 2)
+            continue; //reversing into the neck
+        if(snake_place_occupied(&game->map, neighbors[move]))
+            continue;
+        moves[move_count] = move, move_places[move_count] = neighbors[move];
+        move_count++;
+    }
+    if(move_count == 0)
+        return snake_direction;
+
+    //grow a distance front from the apple until it touches one of the moves
+    bool toward_apple[3] = {false, false, false};
+    if(apple_x != -1 && apple_y != -1)
+    {
+        snake_bitmap front = {{0}};
+        front[apple_y][apple_x >> 5] |= 1u << (apple_x & 31);
+        bool touched = false;
+        while(!touched)
+        {
+            for(short int i = 0; i < move_count; i++)
+                if(snake_bitmap_test_place(front, move_places[i]))
+                    toward_apple[i] = touched = true;
+            if(!touched && !snake_bitmap_grow(front, open))
+                break;
+        }
+    }
+
+    short int best = 0, best_rank = -1, best_area = -1;
+    for(short int i = 0; i < move_count; i++)
+    {
+        snake_bitmap region = {{0}};
+        snake_bitmap_set_place(region, move_places[i]);
+        while(snake_bitmap_grow(region, open))
+            ;
+        bool safe = snake_bitmap_test(region, tail_x, tail_y);
+        short int rank = safe ? (toward_apple[i] ? 2 : 1) : 0;
+        short int area = snake_bitmap_count(region);
+        if(rank > best_rank || (rank == best_rank && area > best_area))
+            best = i, best_rank = rank, best_area = area;
+    }
+    return moves[best];
 }
 
 void snake_draw_frame()
 {
-    short int x1 = (DISPLAY_WIDTH - 4*MAP_WIDTH - 4) / 2 - 1;
-    short int x2 = x1 + 3 + 4 * MAP_WIDTH;
+    short int x1 = (DISPLAY_WIDTH - 4*SNAKE_VIEW_WIDTH - 4) / 2 - 1;
+    short int x2 = x1 + 3 + 4 * SNAKE_VIEW_WIDTH;
     short int y1 = 2;
-    short int y2 = y1 + 3 + 4 * MAP_HEIGHT;
+    short int y2 = y1 + 3 + 4 * SNAKE_VIEW_HEIGHT;
     u8g2_DrawLine(&u8g2, x1, DISPLAY_HEIGHT - y1 ,x1, DISPLAY_HEIGHT - y2);
     u8g2_DrawLine(&u8g2, x2, DISPLAY_HEIGHT - y1 ,x2, DISPLAY_HEIGHT - y2);
     u8g2_DrawLine(&u8g2, x1, DISPLAY_HEIGHT - y1 ,x2, DISPLAY_HEIGHT - y1);
@@ -420,10 +904,26 @@ void snake_draw_score(int score)
     u8g2_DrawStr(&u8g2, 21, DISPLAY_HEIGHT - 48, score_str);
 }
 
-void snake_draw_animal(int x_map, int y_map, int animal_id)
+#define SNAKE_HUD_HEIGHT (DISPLAY_HEIGHT - (SNAKE_Y_OFFSET + 4 * SNAKE_VIEW_HEIGHT + 3))
+
+//wipes the band above the frame holding the score and the animal timer,
+//whole pages are cleared as bytes and only the leftover rows go through u8g2
+void snake_clear_hud()
+{
+    memset(u8g2_GetBufferPtr(&u8g2), 0, (SNAKE_HUD_HEIGHT / 8) * DISPLAY_WIDTH);
+    u8g2_SetDrawColor(&u8g2, 0);
+    u8g2_DrawBox(&u8g2, 0, SNAKE_HUD_HEIGHT & ~7, DISPLAY_WIDTH, SNAKE_HUD_HEIGHT % 8);
+    u8g2_SetDrawColor(&u8g2, 1);
+}
+
+void snake_draw_animal(const snake_state* game, int x_map, int y_map, int animal_id)
 {
-    int x = (DISPLAY_WIDTH - 4*MAP_WIDTH) / 2 + x_map * 4;
-    int y = 6 + y_map * 4; 
+    short int view_x, view_y, right_x, right_y;
+    if(!snake_view_cell(game, x_map, y_map, &view_x, &view_y) ||
+        !snake_view_cell(game, (x_map + 1) % MAP_WIDTH, y_map, &right_x, &right_y) || right_x != view_x + 1)
+        return;
+    int x = SNAKE_X_OFFSET + 1 + view_x * 4;
+    int y = 6 + view_y * 4; 
     switch(animal_id)
     {
         case 0: //lizard
@@ -460,6 +960,12 @@ void snake_draw_animal(int x_map, int y_map, int animal_id)
     }
 }
 
+void snake_draw_demo_label()
+{
+    u8g2_SetFont(&u8g2, u8g2_font_5x8_tr);
+    u8g2_DrawStr(&u8g2, 74, DISPLAY_HEIGHT - 48, "DEMO");
+}
+
 void snake_draw_animal_timer(int animal_timer)
 {
     if(animal_timer <= 0) return;
@@ -470,338 +976,346 @@ void snake_draw_animal_timer(int animal_timer)
     u8g2_DrawStr(&u8g2, 96, DISPLAY_HEIGHT - 48, animal_time_str);
 }
 
-void snake_generate_apple(short int *apple_x, short int *apple_y)
+void snake_generate_apple(snake_state* game)
 {
-    short int apple_pos = rand() % (MAP_HEIGHT * MAP_WIDTH);
-    for(short int i = 0; i < MAP_HEIGHT * MAP_WIDTH; i++)
+    if(game->map.free_count == 0)
     {
-        short int x = (apple_pos + i) % MAP_WIDTH;
-        short int y = ((apple_pos + i)  / MAP_WIDTH) % MAP_HEIGHT;
-        if(!snake_map[y][x])
-        {
-            *apple_x = x;
-            *apple_y = y;
-            return;
-        }
+        game->apple_x = -1;
+        game->apple_y = -1;
+        return;
     }
-    *apple_x = -1;
-    *apple_y = -1;
+    uint16_t cell = game->map.free_cells[rand_r(&game->seed) % game->map.free_count];
+    game->apple_x = cell % MAP_WIDTH;
+    game->apple_y = cell / MAP_WIDTH;
 }
 
-void snake_generate_animal(short int *animal_x, short int *animal_y)
+//the animal needs two free cells side by side, the pairs of a row are its free bits that also
+//have a free right neighbour, so picking one uniformly only takes a popcount per row word
+void snake_generate_animal(snake_state* game)
 {
-    short int animal_pos = rand() % (MAP_HEIGHT * MAP_WIDTH);
-    for(short int i = 0; i < MAP_HEIGHT * MAP_WIDTH; i++)
+    uint32_t pairs[MAP_HEIGHT][SNAKE_ROW_WORDS];
+    short int word_counts[MAP_HEIGHT][SNAKE_ROW_WORDS];
+    short int pair_count = 0;
+    for(short int y = 0; y < MAP_HEIGHT; y++)
     {
-        short int x = (animal_pos + i) % MAP_WIDTH;
-        short int y = ((animal_pos + i)  / MAP_WIDTH) % MAP_HEIGHT;
-        if(x != (MAP_WIDTH - 1) && !snake_map[y][x] && !snake_map[y][x+1])
+        for(short int k = 0; k < SNAKE_ROW_WORDS; k++)
         {
-            *animal_x = x;
-            *animal_y = y;
-            return;
+            //the padding bits past the last column count as occupied, so no pair wraps around
+            uint32_t row = game->map.rows[y][k];
+            uint32_t right = k + 1 < SNAKE_ROW_WORDS ? game->map.rows[y][k + 1] : ~0u;
+            pairs[y][k] = ~row & ~((row >> 1) | (right << 31));
+            word_counts[y][k] = __builtin_popcount(pairs[y][k]);
+            pair_count += word_counts[y][k];
         }
     }
-    *animal_x = -1;
-    *animal_y = -1;
+    if(pair_count == 0)
+    {
+        game->animal_x = -1;
+        game->animal_y = -1;
+        return;
+    }
+
+    short int pick = rand_r(&game->seed) % pair_count;
+    short int word = 0;
+    while(pick >= word_counts[word / SNAKE_ROW_WORDS][word % SNAKE_ROW_WORDS])
+    {
+        pick -= word_counts[word / SNAKE_ROW_WORDS][word % SNAKE_ROW_WORDS];
+        word++;
+    }
+    uint32_t bits = pairs[word / SNAKE_ROW_WORDS][word % SNAKE_ROW_WORDS];
+    while(pick--)
+        bits &= bits - 1;
+    game->animal_x = (word % SNAKE_ROW_WORDS) * 32 + __builtin_ctz(bits);
+    game->animal_y = word / SNAKE_ROW_WORDS;
 }
 
-void snake_draw_apple(short int x_map, short int y_map)
+void snake_draw_apple(const snake_state* game, short int x_map, short int y_map)
 {
     if(x_map == -1 || y_map == -1)
         return;
 
-    short int x = (DISPLAY_WIDTH - 4*MAP_WIDTH) / 2 + x_map * 4;
-    short int y =  6 + y_map * 4;
+    short int view_x, view_y;
+    if(!snake_view_cell(game, x_map, y_map, &view_x, &view_y))
+        return;
+    short int x = SNAKE_X_OFFSET + 1 + view_x * 4;
+    short int y =  6 + view_y * 4;
     u8g2_DrawPixel(&u8g2, x - 1, DISPLAY_HEIGHT - y);
     u8g2_DrawPixel(&u8g2, x + 1, DISPLAY_HEIGHT - y);
     u8g2_DrawPixel(&u8g2, x, DISPLAY_HEIGHT - (y - 1));
     u8g2_DrawPixel(&u8g2, x, DISPLAY_HEIGHT - (y + 1));
 }
 
-void snake_open_mouth(snake_node* snake_head, direction snake_direction)
+void snake_open_mouth(const snake_state* game, direction snake_direction)
 {
-    short int x = (DISPLAY_WIDTH - 4*MAP_WIDTH) / 2 + snake_head->x * 4;
-    short int y = 5 + snake_head->y * 4;
-    switch(snake_direction)
-    {
-        case LEFT:
-            u8g2_DrawPixel(&u8g2, x, DISPLAY_HEIGHT - (y - 1));
-            u8g2_DrawPixel(&u8g2, x, DISPLAY_HEIGHT - (y + 2));
-            u8g2_SetDrawColor(&u8g2, 0);
-            u8g2_DrawPixel(&u8g2, x, DISPLAY_HEIGHT - y);
-            u8g2_DrawPixel(&u8g2, x, DISPLAY_HEIGHT - (y + 1));
-            u8g2_SetDrawColor(&u8g2, 1);
-            break;
-        case RIGHT:
-            u8g2_DrawPixel(&u8g2, x + 1, DISPLAY_HEIGHT - (y - 1));
-            u8g2_DrawPixel(&u8g2, x + 1, DISPLAY_HEIGHT - (y + 2));
-            u8g2_SetDrawColor(&u8g2, 0);
-            u8g2_DrawPixel(&u8g2, x + 1, DISPLAY_HEIGHT - y);
-            u8g2_DrawPixel(&u8g2, x + 1, DISPLAY_HEIGHT - (y + 1));
-            u8g2_SetDrawColor(&u8g2, 1);
-            break;
-        case DOWN:
-            u8g2_DrawPixel(&u8g2, x - 1, DISPLAY_HEIGHT - y);
-            u8g2_DrawPixel(&u8g2, x + 2, DISPLAY_HEIGHT - y);
-            u8g2_SetDrawColor(&u8g2, 0);
-            u8g2_DrawPixel(&u8g2, x, DISPLAY_HEIGHT - y);
-            u8g2_DrawPixel(&u8g2, x + 1, DISPLAY_HEIGHT - y);
-            u8g2_SetDrawColor(&u8g2, 1);
-            break;
-        case UP:
-            u8g2_DrawPixel(&u8g2, x - 1, DISPLAY_HEIGHT - (y + 1));
-            u8g2_DrawPixel(&u8g2, x + 2, DISPLAY_HEIGHT - (y + 1));
-            u8g2_SetDrawColor(&u8g2, 0);
-            u8g2_DrawPixel(&u8g2, x, DISPLAY_HEIGHT - (y + 1));
-            u8g2_DrawPixel(&u8g2, x + 1, DISPLAY_HEIGHT - (y + 1));
-            u8g2_SetDrawColor(&u8g2, 1);
-            break;
-    }
+    snake_segment head = snake_head(&game->body);
+    short int view_x, view_y;
+    if(snake_view_cell(game, SNAKE_SEGMENT_X(head), SNAKE_SEGMENT_Y(head), &view_x, &view_y))
+        snake_blit_tile(view_x, view_y, snake_head_tiles[SNAKE_SEGMENT_DIRECTION(head)][snake_direction + 1]);
 }
 
-void snake_death_scene(snake_node* snake_head, direction snake_direction, int score)
+void snake_death_scene(const snake_state* game)
 {
     for(int i = 0; i < 9; i++)
     {
         u8g2_ClearBuffer(&u8g2);
         snake_draw_frame();
-        snake_draw_score(score);
+        snake_draw_score(game->score);
         if(i % 2)
-            snake_draw_snake(snake_head, snake_direction);
-        u8g2_SendBuffer(&u8g2);
+            snake_draw_snake(game);
+        display_flush();
         vTaskDelay(100 / portTICK_PERIOD_MS);
     }
 }
 
-void snake_run()
+//starts a new game, seed picks its apples and animals so a game can be replayed, with demo set
+//the game is labelled as the attract mode, with ramp set the snake speeds up as it eats
+void snake_reset(snake_state* game, unsigned int seed, bool demo, bool ramp)
 {
-    direction snake_direction;
-    snake_node* snake_head = NULL;
-    int score;
-    short int apple_x, apple_y, apples_till_animal,
-        animal_timer, animal_id, animal_x, animal_y;
-        
+    //the closed head is never blank once snake_atlas_init ran
+    assert(memcmp(snake_head_tiles[0][0], snake_empty_tile, sizeof(snake_tile)));
+    game->seed = seed;
+    game->demo = demo, game->ramp = ramp;
+    game->snake_direction = RIGHT;
+    game->turns.count = 0;
+    snake_board_clear(&game->map);
+    snake_init(game);
+    snake_camera_reset(game, SNAKE_SEGMENT_X(snake_head(&game->body)), SNAKE_SEGMENT_Y(snake_head(&game->body)));
+    game->apple_x = -1, game->apple_y = -1, game->animal_x = -1, game->animal_y = -1;
+    game->apples_till_animal = 4, game->animal_timer = 0, game->score = 0;
+    game->animal_id = rand_r(&game->seed) % 3;
+    game->tick_ms = ramp ? SNAKE_RAMP_START_MS : SNAKE_TICK_MS, game->apples_till_ramp = SNAKE_RAMP_APPLES;
+    game->old_tail = 0, game->tail_moved = false, game->redraw = true;
+}
+
+bool snake_animal_visible(const snake_state* game)
+{
+    return game->animal_x != -1 && game->animal_y != -1 && game->animal_timer > 0;
+}
+
+//advances the game by one tick heading for turn, a reversal into the neck keeps going straight,
+//returns false when the snake runs into itself and leaves the game as it was before the move
+bool snake_step(snake_state* game, direction turn)
+{
+    if(turn != ((game->snake_direction + 2) & 3))
+        game->snake_direction = turn;
+    if(snake_collision_check(game, game->snake_direction))
+        return false;
+
+    bool animal_was_visible = snake_animal_visible(game);
+    snake_add_segment(game, game->snake_direction);
+    snake_segment head = snake_head(&game->body);
+
+    //check if apple is eaten
+    game->tail_moved = true;
+    if(SNAKE_SEGMENT_X(head) == game->apple_x && SNAKE_SEGMENT_Y(head) == game->apple_y)
+    {
+        game->tail_moved = false;
+        game->score += 7;
+        game->apple_x = -1;
+        game->apple_y = -1;
+        snake_mark_eaten(&game->body);
+        game->apples_till_animal--;
+        if(game->ramp && --game->apples_till_ramp == 0 && game->tick_ms > SNAKE_RAMP_MIN_MS)
+        {
+            game->apples_till_ramp = SNAKE_RAMP_APPLES;
+            game->tick_ms -= SNAKE_RAMP_STEP_MS;
+        }
+    }
+    else
+        game->old_tail = snake_pop_last_segment(game);
+
+    //generate new apple if previous one got eaten
+    if(game->apple_x == -1 || game->apple_y == -1)
+        snake_generate_apple(game);
+
+    //check if animal is eaten
+    if(game->animal_timer > 0 && game->animal_y == SNAKE_SEGMENT_Y(head) &&
+        (game->animal_x == SNAKE_SEGMENT_X(head) || (game->animal_x + 1) == SNAKE_SEGMENT_X(head)))
+    {
+        game->score += game->animal_timer;
+        game->animal_timer = 0;
+        game->animal_x = -1; game->animal_y = -1;
+        snake_mark_eaten(&game->body);
+    }
+    if(game->animal_timer > 0)
+        game->animal_timer--;
+
+    //generate animal on every 5th apple
+    if(game->apples_till_animal == 0)
+    {
+        game->apples_till_animal = 5;
+        game->animal_timer = 20;
+        game->animal_id = rand_r(&game->seed) % 3;
+        if(game->apple_x != -1 && game->apple_y != -1)
+        {
+            snake_occupy_cell(&game->map, game->apple_x, game->apple_y);
+            snake_generate_animal(game);
+            snake_release_cell(&game->map, game->apple_x, game->apple_y);
+        }
+        else
+            snake_generate_animal(game);
+    }
+
+    if(animal_was_visible && !snake_animal_visible(game))
+        game->redraw = true; //the animal can overlap the snake, so repaint it all once
+    if(snake_camera_follow(game, SNAKE_SEGMENT_X(head), SNAKE_SEGMENT_Y(head)))
+        game->redraw = true;
+    return true;
+}
+
+//frames a tick is drawn in, a repaint of the whole view has nothing to slide
+short int snake_render_frames(const snake_state* game)
+{
+    return game->redraw ? 1 : SNAKE_FRAMES_PER_TICK;
+}
+
+//draws frame of frames after the last step, the buffer is kept between ticks so only the cells
+//a move changed get patched, once per frame while the head and tail slide into their new cells
+void snake_render(snake_state* game, short int frame, short int frames)
+{
+    snake_segment head = snake_head(&game->body);
+    bool animal_visible = snake_animal_visible(game);
+    bool mouth_open = snake_apple_in_front(&game->body, game->snake_direction, game->apple_x, game->apple_y);
+    if(game->redraw)
+    {
+        u8g2_ClearBuffer(&u8g2);
+        snake_draw_frame();
+        snake_draw_view(game);
+        game->redraw = false;
+    }
+    else
+    {
+        const uint8_t* head_tile = snake_head_tiles[SNAKE_SEGMENT_DIRECTION(head)][mouth_open ? game->snake_direction + 1 : 0];
+        snake_draw_motion(game, game->old_tail, game->tail_moved, 4 * frame / frames, head_tile);
+        if(frame == 1)
+            snake_clear_hud();
+    }
+    if(frame == frames && mouth_open)
+        snake_open_mouth(game, game->snake_direction);
+    if(frame == 1)
+    {
+        snake_draw_score(game->score);
+        if(game->demo)
+            snake_draw_demo_label();
+        if(animal_visible)
+            snake_draw_animal_timer(game->animal_timer);
+    }
+    snake_draw_apple(game, game->apple_x, game->apple_y);
+    if(animal_visible)
+        snake_draw_animal(game, game->animal_x, game->animal_y, game->animal_id);
+}
+
+//plays one game on the console and returns the score, with demo set the autopilot steers and
+//any button press ends the game early with -1, with ramp set the snake speeds up as it eats
+int snake_play(bool demo, bool ramp)
+{
+    snake_state* game = &snake_game;
+    game_clock loop;
+    input_event event;
+
+    snake_reset(game, rand(), demo, ramp);
+    game_clock_start(&loop, demo ? "snake demo" : "snake", game->tick_ms);
+
+    //play loop
     while(true)
     {
-        //initialize variables
-        snake_direction = RIGHT;
-        snake_head = snake_init();
-        memset(snake_map, 0, sizeof(snake_map));
-        apple_x = -1; apple_y = -1, animal_x = -1, animal_y = -1;
-        apples_till_animal = 4, animal_timer = 0, score = 0;
-        animal_id = rand() % 3;
-        snake_start_screen();
+        PROFILE_BEGIN(PROFILE_INPUT);
+        while(input_poll(&event))
+        {
+            if(demo && event.pressed)
+                return -1;
+            //buttons are in direction order
+            if(event.pressed && event.button < INPUT_BUTTON_COUNT)
+                snake_turns_push(&game->turns, game->snake_direction, (direction)event.button);
+        }
+        direction turn = snake_turns_pop(&game->turns, game->snake_direction);
+        if(demo)
+            turn = snake_autopilot(game, turn);
+        PROFILE_END(PROFILE_INPUT);
+
+        PROFILE_BEGIN(PROFILE_UPDATE);
+        short int tick_ms = game->tick_ms;
+        if(!snake_step(game, turn))
+        {
+            snake_death_scene(game);
+            break;
+        }
+        if(game->tick_ms != tick_ms)
+            game_clock_set_period(&loop, game->tick_ms);
+        PROFILE_END(PROFILE_UPDATE);
 
-        //check for any button press to start
-        esp_light_sleep_start();
-    
-        //play loop
-        while(true)
+        short int frames = snake_render_frames(game);
+        for(short int frame = 1; frame <= frames; frame++)
         {
-            u8g2_ClearBuffer(&u8g2);
-
-            if(gpio_get_level(LEFT_BUTTON) && snake_direction != RIGHT)
-                snake_direction = LEFT;
-            if(gpio_get_level(DOWN_BUTTON) && snake_direction != UP)
-                snake_direction = DOWN;
-            if(gpio_get_level(RIGHT_BUTTON) && snake_direction != LEFT)
-                snake_direction = RIGHT;
-            if(gpio_get_level(UP_BUTTON) && snake_direction != DOWN)
-                snake_direction = UP;
-
-            if(snake_collision_check(snake_head, snake_direction))
-            {
-                snake_death_scene(snake_head, snake_direction, score);
-                break;
-            }
-
-            snake_head = snake_add_segment(snake_head, snake_direction);
-
-            //check if apple is eaten
-            if(snake_head->x == apple_x && snake_head->y == apple_y)
-            {
-                score += 7;
-                apple_x = -1;
-                apple_y = -1;
-                snake_head->eaten = true;
-                apples_till_animal--;
-            }
-            else
-                snake_pop_last_segment(snake_head);
-
-            //generate new apple if previous one got eaten
-            if(apple_x == -1 || apple_y == -1)
-                snake_generate_apple(&apple_x, &apple_y);
-
-            //check if animal is eaten
-            if(animal_timer > 0 && animal_y == snake_head->y &&
-                (animal_x == snake_head->x || (animal_x + 1) == snake_head->x))
-            {
-                score += animal_timer;
-                animal_timer = 0;
-                animal_x = -1; animal_y = -1;
-                snake_head->eaten = true;
-            }
-            if(animal_timer > 0)
-                animal_timer--;
-
-            //generate animal on every 5th apple
-            if(apples_till_animal == 0)
-            {
-                apples_till_animal = 5;
-                animal_timer = 20;
-                animal_id = rand() % 3;
-                if(apple_x != -1 && apple_y != -1)
-                {
-                    snake_map[apple_y][apple_x] = true;
-                    snake_generate_animal(&animal_x, &animal_y);
-                    snake_map[apple_y][apple_x] = false;
-                }
-                else
-                    snake_generate_animal(&animal_x, &animal_y);
-            }
-
-            //render everything
-            snake_draw_snake(snake_head, snake_direction);
-            if(snake_apple_in_front(snake_head, snake_direction, apple_x, apple_y))
-                snake_open_mouth(snake_head, snake_direction);
-            snake_draw_frame();
-            snake_draw_score(score);
-            snake_draw_apple(apple_x, apple_y);
-            if(animal_x != -1 && animal_y != -1 && animal_timer > 0)
-            {
-                snake_draw_animal_timer(animal_timer);
-                snake_draw_animal(animal_x, animal_y, animal_id);
-            }
-
-            u8g2_SendBuffer(&u8g2);
-            vTaskDelay(50 / portTICK_PERIOD_MS);
+            //a frame that is already late is skipped rather than delaying the next tick, the last
+            //one always comes since it leaves the cells the next tick patches complete
+            if(frame > 1 && !game_clock_wait_step(&loop, frame - 1, frames))
+                continue;
+
+            PROFILE_BEGIN(PROFILE_DRAW);
+            snake_render(game, frame, frames);
+            PROFILE_FRAME();
+            PROFILE_END(PROFILE_DRAW);
+
+            PROFILE_BEGIN(PROFILE_FLUSH);
+            display_flush();
+            PROFILE_END(PROFILE_FLUSH);
         }
+        game_clock_wait(&loop);
+    }
+    game_clock_report(&loop);
+    return game->score;
+}
 
+void snake_run()
+{
+    while(true)
+    {
+        snake_start_screen();
+
+        //any button starts a normal game, up starts the speed ramp
+        bool ramp = input_sleep_until_press() & INPUT_MASK(INPUT_UP);
+        input_flush();
+        int score = snake_play(false, ramp);
         snake_end_screen(score);
-        snake_free_memory(snake_head);
 
         //wait for play again or exit button press
-        esp_light_sleep_start();
-        if(!gpio_get_level(LEFT_BUTTON))
+        if(!(input_sleep_until_press() & INPUT_MASK(INPUT_LEFT)))
             break; //exit game
     }
 }
 
-void snake_draw_left_frame()
+//attract mode for the menu, the autopilot plays game after game until a button is pressed
+void snake_demo()
 {
-    snake_node segment_1, segment_2, segment_3, segment_4, segment_5, segment_6, 
-    segment_7, segment_8, segment_9, segment_10, segment_11, segment_12, segment_13, 
-    segment_14, segment_15, segment_16;
+    while(snake_play(true, false) >= 0)
+        ;
+}
 
+void snake_draw_left_frame()
+{
+    //the game is not running while the menu shows, so the thumbnails borrow its body
+    snake_state* game = &snake_game;
     short int head_x = 3, head_y = 9;
-    segment_1.x = head_x;      segment_1.y = head_y;
-    segment_2.x = head_x - 1;  segment_2.y = head_y;
-    segment_3.x = head_x - 2;  segment_3.y = head_y;
-    segment_4.x = head_x - 3;  segment_4.y = head_y;
-    segment_5.x = head_x - 3;  segment_5.y = head_y - 1;
-    segment_6.x = head_x - 3;  segment_6.y = head_y - 2;
-    segment_7.x = head_x - 2;  segment_7.y = head_y - 2;
-    segment_8.x = head_x - 1;  segment_8.y = head_y - 2;
-    segment_9.x = head_x;      segment_9.y = head_y - 2;
-    segment_10.x = head_x + 1; segment_10.y = head_y - 2;
-    segment_11.x = head_x + 1; segment_11.y = head_y - 3;
-    segment_12.x = head_x + 1; segment_12.y = head_y - 4;
-    segment_13.x = head_x;     segment_13.y = head_y - 4;
-    segment_14.x = head_x - 1; segment_14.y = head_y - 4;
-    segment_15.x = head_x - 2; segment_15.y = head_y - 4;
-    segment_16.x = head_x - 3; segment_16.y = head_y - 4;
-
-    segment_2.next_direction = LEFT;  segment_3.next_direction = LEFT;
-    segment_4.next_direction = DOWN;  segment_5.next_direction = DOWN;
-    segment_6.next_direction = RIGHT; segment_7.next_direction = RIGHT;
-    segment_8.next_direction = RIGHT; segment_9.next_direction = RIGHT;
-    segment_10.next_direction = DOWN; segment_11.next_direction = DOWN;
-    segment_12.next_direction = LEFT; segment_13.next_direction = LEFT;
-    segment_14.next_direction = LEFT; segment_15.next_direction = LEFT;
-    segment_16.next_direction = LEFT; segment_1.next_direction = LEFT;
-
-    segment_1.eaten = false; segment_2.eaten = false; segment_3.eaten = false;
-    segment_4.eaten = false; segment_5.eaten = false; segment_6.eaten = false;
-    segment_7.eaten = true;  segment_8.eaten = false; segment_9.eaten = false;
-    segment_10.eaten = false;segment_11.eaten = false;segment_12.eaten = false;
-    segment_13.eaten = false;segment_14.eaten = false;segment_15.eaten = false;
-    segment_16.eaten = false;
-
-    segment_1.next = &segment_2; segment_2.next = &segment_3; segment_3.next = &segment_4;
-    segment_4.next = &segment_5; segment_5.next = &segment_6; segment_6.next = &segment_7;
-    segment_7.next = &segment_8; segment_8.next = &segment_9; segment_9.next = &segment_10;
-    segment_10.next = &segment_11; segment_11.next = &segment_12; segment_12.next = &segment_13;
-    segment_13.next = &segment_14; segment_14.next = &segment_15; segment_15.next = &segment_16;
-    segment_16.next = NULL;
-    snake_draw_snake(&segment_1, RIGHT);
-    snake_open_mouth(&segment_1, RIGHT);
-    snake_draw_apple(head_x + 1, head_y);
+    game->camera_x = 0, game->camera_y = 0;
+
+    snake_body_trace(&game->body, head_x, head_y, "LLLDDRRRRDDLLLL", 1 << 6);
+    snake_draw_snake(game);
+    snake_open_mouth(game, RIGHT);
+    snake_draw_apple(game, head_x + 1, head_y);
 }
 
 void snake_draw_middle_frame()
 {
-    snake_node segment_1, segment_2, segment_3, segment_4, segment_5, segment_6, 
-    segment_7, segment_8, segment_9, segment_10, segment_11, segment_12, segment_13, 
-    segment_14, segment_15, segment_16, segment_17, segment_18, segment_19, segment_0;
-
-    segment_0.next = &segment_1, segment_0.eaten = false;
-    segment_0.next_direction = LEFT;
-    segment_0.x = 12, segment_0.y = 9;
-
-    short int head_x = 11, head_y = 9;
-    segment_1.x = head_x;      segment_1.y = head_y;
-    segment_2.x = head_x - 1;  segment_2.y = head_y;
-    segment_3.x = head_x - 2;  segment_3.y = head_y;
-    segment_4.x = head_x - 3;  segment_4.y = head_y;
-    segment_5.x = head_x - 3;  segment_5.y = head_y - 1;
-    segment_6.x = head_x - 3;  segment_6.y = head_y - 2;
-    segment_7.x = head_x - 2;  segment_7.y = head_y - 2;
-    segment_8.x = head_x - 1;  segment_8.y = head_y - 2;
-    segment_9.x = head_x;      segment_9.y = head_y - 2;
-    segment_10.x = head_x + 1; segment_10.y = head_y - 2;
-    segment_11.x = head_x + 2; segment_11.y = head_y - 2;
-    segment_12.x = head_x + 2; segment_12.y = head_y - 3;
-    segment_13.x = head_x + 2; segment_13.y = head_y - 4;
-    segment_14.x = head_x + 2; segment_14.y = head_y - 5;
-    segment_15.x = head_x + 1; segment_15.y = head_y - 5;
-    segment_16.x = head_x;     segment_16.y = head_y - 5;
-    segment_17.x = head_x - 1; segment_17.y = head_y - 5;
-    segment_18.x = head_x - 2; segment_18.y = head_y - 5;
-    segment_19.x = head_x - 3; segment_19.y = head_y - 5;
-
-    segment_2.next_direction = LEFT;  segment_3.next_direction = LEFT;
-    segment_4.next_direction = DOWN;  segment_5.next_direction = DOWN;
-    segment_6.next_direction = RIGHT; segment_7.next_direction = RIGHT;
-    segment_8.next_direction = RIGHT; segment_9.next_direction = RIGHT;
-    segment_10.next_direction = RIGHT; segment_11.next_direction = DOWN;
-    segment_12.next_direction = DOWN; segment_13.next_direction = DOWN;
-    segment_14.next_direction = LEFT; segment_15.next_direction = LEFT; 
-    segment_16.next_direction = LEFT; segment_17.next_direction = LEFT;
-    segment_18.next_direction = LEFT; segment_19.next_direction = LEFT;
-    segment_1.next_direction = LEFT;
-
-    segment_1.eaten = false; segment_2.eaten = false; segment_3.eaten = false;
-    segment_4.eaten = false; segment_5.eaten = false; segment_6.eaten = false;
-    segment_7.eaten = true;  segment_8.eaten = false; segment_9.eaten = false;
-    segment_10.eaten = false;segment_11.eaten = false;segment_12.eaten = false;
-    segment_13.eaten = true; segment_14.eaten = false;segment_15.eaten = false;
-    segment_16.eaten = false;segment_17.eaten = false;segment_18.eaten = false;
-    segment_19.eaten = false;
-
-    segment_1.next = &segment_2; segment_2.next = &segment_3; segment_3.next = &segment_4;
-    segment_4.next = &segment_5; segment_5.next = &segment_6; segment_6.next = &segment_7;
-    segment_7.next = &segment_8; segment_8.next = &segment_9; segment_9.next = &segment_10;
-    segment_10.next = &segment_11; segment_11.next = &segment_12; segment_12.next = &segment_13;
-    segment_13.next = &segment_14; segment_14.next = &segment_15; segment_15.next = &segment_16;
-    segment_16.next = &segment_17; segment_17.next = &segment_18; segment_18.next = &segment_19;
-    segment_19.next = NULL;
-
-    snake_draw_snake(&segment_0, RIGHT);
-    snake_open_mouth(&segment_0, RIGHT);
-    snake_draw_apple(head_x + 2, head_y);
-    snake_draw_animal(9, 5, 1);
+    snake_state* game = &snake_game;
+    short int head_x = 12, head_y = 9;
+    game->camera_x = 0, game->camera_y = 0;
+
+    snake_body_trace(&game->body, head_x, head_y, "LLLLDDRRRRRDDDLLLLL", (1 << 7) | (1 << 13));
+    snake_draw_snake(game);
+    snake_open_mouth(game, RIGHT);
+    snake_draw_apple(game, head_x + 1, head_y);
+    snake_draw_animal(game, 9, 5, 1);
 }
 
 void snake_draw_right_frame()
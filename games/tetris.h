@@ -9,30 +9,210 @@
 #include "sdkconfig.h"
 #include "driver/rtc_io.h"
 #include "../main/globals.h"
+#include "../main/display.h"
+#include "../main/game_clock.h"
+#include "../main/input.h"
+#include "../main/highscores.h"
+#include "../main/profiler.h"
 
 #define TETRIS_BLOCK_SIZE 3
 #define TETRIS_MAP_WIDTH  10
 #define TETRIS_MAP_HEIGHT 20
 #define TETRIS_MAX_SPEED  5
 #define TETRIS_NUMBER_OF_BLOCKS 9
-
-static bool tetris_map[20][10];
+#define TETRIS_TICK_MS 40
+#define TETRIS_REPEAT_DELAY_US 250000 //hold time before left/right start repeating
+#define TETRIS_DOUBLE_TAP_US   300000 //a second down press within this drops the piece at once
+#ifndef TETRIS_PREVIEWS
+#define TETRIS_PREVIEWS 3   //upcoming pieces shown beside the board
+#endif
+#define TETRIS_QUEUE_SIZE 4 //ring of upcoming pieces, a power of two of at least TETRIS_PREVIEWS
+
+#if TETRIS_PREVIEWS < 1 || TETRIS_PREVIEWS > 3
+#error "tetris has room for 1 to 3 previews"
+#endif
+
+//the board keeps a bit per cell, a row holds its columns in bits 3 to 12 and has every other
+//bit set as wall, and the rows under the floor are all wall, so a piece anywhere near the well
+//fits exactly when none of its rows overlaps the board
+#define TETRIS_WALL_BITS   3
+#define TETRIS_FLOOR_ROWS  3
+#define TETRIS_CELL(col)   (1u << ((col) + TETRIS_WALL_BITS))
+#define TETRIS_EMPTY_ROW   ((uint16_t)~(((1u << TETRIS_MAP_WIDTH) - 1) << TETRIS_WALL_BITS))
+#define TETRIS_FULL_ROW    0xffff
+
+static uint16_t tetris_board[TETRIS_FLOOR_ROWS + TETRIS_MAP_HEIGHT];
+static uint16_t* const tetris_rows = tetris_board + TETRIS_FLOOR_ROWS;   //row 0 is the bottom one
 
 typedef enum block_rotation
 {
     NO_ROTATION, LEFT_90, RIGHT_90, UPSIDE_DOWN
 } block_rotation;
 
-void tetris_shift_rows_down(short int starting_row, short int amount)
+//a piece is 4 rows of 4 cells for each rotation, row k lies k rows below the piece position and
+//its cells cover the columns from one left of the position to two right of it
+#define TETRIS_PIECE_ROW(a, b, c, d) ((a) | (b) << 1 | (c) << 2 | (d) << 3)
+
+static const uint8_t tetris_pieces[TETRIS_NUMBER_OF_BLOCKS][4][4] =
+{
+    {   //single block
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //NO_ROTATION
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //LEFT_90
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //RIGHT_90
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //UPSIDE_DOWN
+    },
+    {   //2x2 block
+        {TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //NO_ROTATION
+        {TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //LEFT_90
+        {TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //RIGHT_90
+        {TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //UPSIDE_DOWN
+    },
+    {   //small L block
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //NO_ROTATION
+        {TETRIS_PIECE_ROW(0,0,1,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //LEFT_90
+        {TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //RIGHT_90
+        {TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //UPSIDE_DOWN
+    },
+    {   //t block
+        {TETRIS_PIECE_ROW(1,1,1,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //NO_ROTATION
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //LEFT_90
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(1,1,0,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //RIGHT_90
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(1,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //UPSIDE_DOWN
+    },
+    {   //z block
+        {TETRIS_PIECE_ROW(1,1,0,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //NO_ROTATION
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(1,1,0,0), TETRIS_PIECE_ROW(1,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //LEFT_90
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(1,1,0,0), TETRIS_PIECE_ROW(1,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //RIGHT_90
+        {TETRIS_PIECE_ROW(1,1,0,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //UPSIDE_DOWN
+    },
+    {   //reverse z block
+        {TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(1,1,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //NO_ROTATION
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,1,0), TETRIS_PIECE_ROW(0,0,0,0)},   //LEFT_90
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,1,0), TETRIS_PIECE_ROW(0,0,0,0)},   //RIGHT_90
+        {TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(1,1,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //UPSIDE_DOWN
+    },
+    {   //L block
+        {TETRIS_PIECE_ROW(0,0,1,0), TETRIS_PIECE_ROW(1,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //NO_ROTATION
+        {TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,1,0), TETRIS_PIECE_ROW(0,0,1,0), TETRIS_PIECE_ROW(0,0,0,0)},   //LEFT_90
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,0,0)},   //RIGHT_90
+        {TETRIS_PIECE_ROW(1,1,1,0), TETRIS_PIECE_ROW(1,0,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //UPSIDE_DOWN
+    },
+    {   //reverse L block
+        {TETRIS_PIECE_ROW(1,0,0,0), TETRIS_PIECE_ROW(1,1,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //NO_ROTATION
+        {TETRIS_PIECE_ROW(0,0,1,0), TETRIS_PIECE_ROW(0,0,1,0), TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,0,0,0)},   //LEFT_90
+        {TETRIS_PIECE_ROW(0,1,1,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //RIGHT_90
+        {TETRIS_PIECE_ROW(1,1,1,0), TETRIS_PIECE_ROW(0,0,1,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //UPSIDE_DOWN
+    },
+    {   //4x1 long block
+        {TETRIS_PIECE_ROW(1,1,1,1), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //NO_ROTATION
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,0,0)},   //LEFT_90
+        {TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,0,0), TETRIS_PIECE_ROW(0,1,0,0)},   //RIGHT_90
+        {TETRIS_PIECE_ROW(1,1,1,1), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0), TETRIS_PIECE_ROW(0,0,0,0)},   //UPSIDE_DOWN
+    },
+};
+
+//how many rows up to and including the highest filled cell of each column, kept up to date by
+//every change to the board so a landing row is found without probing the rows one by one
+static uint8_t tetris_heights[TETRIS_MAP_WIDTH];
+
+//walks down from the top once, a column gets its height from the first row that has its cell
+void tetris_update_heights()
 {
-    for(int row = starting_row; row < TETRIS_MAP_HEIGHT - amount; row++)
+    memset(tetris_heights, 0, sizeof(tetris_heights));
+    uint16_t seen = TETRIS_EMPTY_ROW;
+    for(short int row = TETRIS_MAP_HEIGHT - 1; row >= 0 && seen != TETRIS_FULL_ROW; row--)
     {
-        memcpy(tetris_map[row], tetris_map[row + amount], sizeof(tetris_map[row]));
+        uint16_t found = tetris_rows[row] & ~seen;
+        seen |= found;
+        for(; found; found &= found - 1)
+            tetris_heights[__builtin_ctz(found) - TETRIS_WALL_BITS] = row + 1;
     }
-    for(int row = TETRIS_MAP_HEIGHT - amount; row < TETRIS_MAP_HEIGHT; row++)
+}
+
+//pieces are dealt from a shuffled bag holding one of each, so no piece stays away for more than
+//two bags, and the dealt ones wait in a ring that the previews read ahead in
+typedef struct tetris_queue
+{
+    unsigned int seed;      //rand_r state for the shuffles
+    uint8_t bag[TETRIS_NUMBER_OF_BLOCKS];
+    short int bag_left;     //the pieces at the front of the bag are not dealt yet
+    uint8_t ring[TETRIS_QUEUE_SIZE];
+    uint8_t head;           //the next piece, the ring is always full
+} tetris_queue;
+
+static tetris_queue tetris_upcoming;
+
+short int tetris_deal_piece(tetris_queue* queue)
+{
+    if(queue->bag_left == 0)
     {
-        memset(tetris_map[row], 0, sizeof(tetris_map[row]));
+        for(short int i = 0; i < TETRIS_NUMBER_OF_BLOCKS; i++)
+            queue->bag[i] = i;
+        for(short int i = TETRIS_NUMBER_OF_BLOCKS - 1; i > 0; i--)
+        {
+            short int j = rand_r(&queue->seed) % (i + 1);
+            uint8_t swap = queue->bag[i];
+            queue->bag[i] = queue->bag[j];
+            queue->bag[j] = swap;
+        }
+        queue->bag_left = TETRIS_NUMBER_OF_BLOCKS;
     }
+    return queue->bag[--queue->bag_left];
+}
+
+//the same seed deals the same pieces in the same order
+void tetris_queue_reset(tetris_queue* queue, unsigned int seed)
+{
+    queue->seed = seed;
+    queue->bag_left = 0;
+    queue->head = 0;
+    for(short int i = 0; i < TETRIS_QUEUE_SIZE; i++)
+        queue->ring[i] = tetris_deal_piece(queue);
+}
+
+//the piece n places after the next one
+short int tetris_peek_piece(const tetris_queue* queue, short int n)
+{
+    return queue->ring[(queue->head + n) & (TETRIS_QUEUE_SIZE - 1)];
+}
+
+short int tetris_next_piece(tetris_queue* queue)
+{
+    short int id = queue->ring[queue->head];
+    queue->ring[queue->head] = tetris_deal_piece(queue);
+    queue->head = (queue->head + 1) & (TETRIS_QUEUE_SIZE - 1);
+    return id;
+}
+
+void tetris_clear_board()
+{
+    for(short int row = -TETRIS_FLOOR_ROWS; row < 0; row++)
+        tetris_rows[row] = TETRIS_FULL_ROW;
+    for(short int row = 0; row < TETRIS_MAP_HEIGHT; row++)
+        tetris_rows[row] = TETRIS_EMPTY_ROW;
+    memset(tetris_heights, 0, sizeof(tetris_heights));
+}
+
+//bit n is set when row n is complete, a full row has no gap left between its walls
+uint32_t tetris_full_rows()
+{
+    uint32_t rows = 0;
+    for(short int row = 0; row < TETRIS_MAP_HEIGHT; row++)
+        if(tetris_rows[row] == TETRIS_FULL_ROW)
+            rows |= 1u << row;
+    return rows;
+}
+
+//removes the rows in the mask in one pass, wherever they are, and lets the rest drop down in order
+void tetris_clear_rows(uint32_t rows)
+{
+    short int kept = 0;
+    for(short int row = 0; row < TETRIS_MAP_HEIGHT; row++)
+        if(!(rows & (1u << row)))
+            tetris_rows[kept++] = tetris_rows[row];
+    while(kept < TETRIS_MAP_HEIGHT)
+        tetris_rows[kept++] = TETRIS_EMPTY_ROW;
+    tetris_update_heights();
 }
 
 void tetris_start_screen()
@@ -51,7 +231,7 @@ void tetris_start_screen()
     short int prompt_x = (DISPLAY_WIDTH - prompt_width) / 2;
     u8g2_DrawStr(&u8g2, prompt_x, 60, prompt);
 
-    u8g2_SendBuffer(&u8g2);
+    display_flush();
 }
 
 void tetris_end_screen(int score)
@@ -79,10 +259,11 @@ void tetris_end_screen(int score)
     u8g2_DrawStr(&u8g2, 5, 60, "Play Again");
     u8g2_DrawStr(&u8g2, 95, 60, "Exit");
 
-    u8g2_SendBuffer(&u8g2);
+    display_flush();
 
     if (score > tetris_highscore)
         tetris_highscore = score;
+    highscores_commit();
 }
 
 void tetris_draw_frame()
@@ -97,245 +278,103 @@ void tetris_draw_frame()
     u8g2_DrawLine(&u8g2, x2, DISPLAY_HEIGHT - y2, x2, DISPLAY_HEIGHT - y1);
 }
 
-void tetris_draw_blocks()
+void tetris_draw_cell(short int col, short int row)
 {
     short int x_offset = DISPLAY_WIDTH/2 + 1;
     short int y_offset = (DISPLAY_HEIGHT - TETRIS_BLOCK_SIZE*TETRIS_MAP_HEIGHT - 2)/2 + 1;
+    u8g2_DrawBox(&u8g2, x_offset + col*TETRIS_BLOCK_SIZE,
+        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + row*TETRIS_BLOCK_SIZE),
+        TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
+}
+
+//the landing preview, an outline of every cell of the piece
+void tetris_draw_ghost_block(short int map_x, short int map_y, short int id, block_rotation rotation)
+{
+    short int x_offset = DISPLAY_WIDTH/2 + 1;
+    short int y_offset = (DISPLAY_HEIGHT - TETRIS_BLOCK_SIZE*TETRIS_MAP_HEIGHT - 2)/2 + 1;
+    const uint8_t* piece = tetris_pieces[id][rotation];
+    for(short int k = 0; k < 4; k++)
+        for(short int i = 0; i < 4; i++)
+            if(piece[k] & (1 << i))
+                u8g2_DrawFrame(&u8g2, x_offset + (map_x - 1 + i)*TETRIS_BLOCK_SIZE,
+                    DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - k)*TETRIS_BLOCK_SIZE),
+                    TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
+}
+
+void tetris_draw_blocks()
+{
     for(int row = 0; row < TETRIS_MAP_HEIGHT; row++)
     {
         for(int col = 0; col < TETRIS_MAP_WIDTH; col++)
         {
-            if(tetris_map[row][col])
-                u8g2_DrawBox(&u8g2, x_offset + col*TETRIS_BLOCK_SIZE,
-                    DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + row*TETRIS_BLOCK_SIZE),
-                    TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
+            if(tetris_rows[row] & TETRIS_CELL(col))
+                tetris_draw_cell(col, row);
         }
     }
 }
 
 void tetris_draw_active_block(short int map_x, short int map_y, short int id, block_rotation rotation)
 {
-    short int x_offset = DISPLAY_WIDTH/2 + 1;
-    short int y_offset = (DISPLAY_HEIGHT - TETRIS_BLOCK_SIZE*TETRIS_MAP_HEIGHT - 2)/2 + 1;
+    if(id < 0)
+        return;
+    const uint8_t* piece = tetris_pieces[id][rotation];
+    for(short int k = 0; k < 4; k++)
+        for(short int i = 0; i < 4; i++)
+            if(piece[k] & (1 << i))
+                tetris_draw_cell(map_x - 1 + i, map_y - k);
+}
+
+//a small picture of the piece in a box whose top left inside corner is at x, y
+void tetris_draw_preview(short int id, int preview_x, int preview_y)
+{
+    u8g2_DrawFrame(&u8g2, preview_x - 1, preview_y - 1, 18, 12);
     switch(id)
     {
         case 0: //single block
-            u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                    DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                    TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);       
+            u8g2_DrawBox(&u8g2, preview_x + 7, preview_y + 4, 2, 2);
             break;
 
         case 1: //2x2 block
-            u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                    DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                    2*TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);       
+            u8g2_DrawBox(&u8g2, preview_x + 6, preview_y + 3, 4, 4);
             break;
 
         case 2: //small L block
-            u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                    DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                    2*TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);       
-            u8g2_SetDrawColor(&u8g2, 0);
-            switch (rotation)
-            {
-                case NO_ROTATION:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x + 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);       
-                    break;
-                case RIGHT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x + 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);       
-                    break;
-                case UPSIDE_DOWN:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);       
-                    break;
-                case LEFT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);       
-                    break;
-            }
-            u8g2_SetDrawColor(&u8g2, 1);
+            u8g2_DrawBox(&u8g2, preview_x + 6, preview_y + 3, 2, 4);
+            u8g2_DrawBox(&u8g2, preview_x + 8, preview_y + 5, 2, 2);
             break;
 
         case 3: //t block
-            u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                    DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                    TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        3*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-                case RIGHT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 2)*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-                case UPSIDE_DOWN:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        3*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-                case LEFT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 2)*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x + 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-            } break;
+            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 3, 6, 2);
+            u8g2_DrawBox(&u8g2, preview_x + 7, preview_y + 5, 2, 2);
+            break;
 
         case 4: //z block
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                case UPSIDE_DOWN:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-                case RIGHT_90:
-                case LEFT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    break;
-            } break;
+            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 3, 4, 2);
+            u8g2_DrawBox(&u8g2, preview_x + 7, preview_y + 5, 4, 2);
+            break;
 
         case 5: //reverse z block
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                case UPSIDE_DOWN:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-                case RIGHT_90:
-                case LEFT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x + 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    break;
-            } break;
+            u8g2_DrawBox(&u8g2, preview_x + 7, preview_y + 3, 4, 2);
+            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 5, 4, 2);
+            break;
 
         case 6: //L block
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x + 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-                case RIGHT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 2)*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    break;
-                case UPSIDE_DOWN:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-                case LEFT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x + 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    break;
-            } break;
+            u8g2_DrawBox(&u8g2, preview_x + 9, preview_y + 3, 2, 2);
+            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 5, 6, 2);
+            break;
 
         case 7: //reverse L block
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-                case RIGHT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 1)*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    break;
-                case UPSIDE_DOWN:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x + 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-                case LEFT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x + 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 2*TETRIS_BLOCK_SIZE);
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + (map_y - 2)*TETRIS_BLOCK_SIZE),
-                        2*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-            } break;
+            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 3, 2, 2);
+            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 5, 6, 2);
+            break;
 
         case 8: //4x1 long block
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                case UPSIDE_DOWN:
-                    u8g2_DrawBox(&u8g2, x_offset + (map_x - 1)*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        4*TETRIS_BLOCK_SIZE, TETRIS_BLOCK_SIZE);
-                    break;
-                case RIGHT_90:
-                case LEFT_90:
-                    u8g2_DrawBox(&u8g2, x_offset + map_x*TETRIS_BLOCK_SIZE,
-                        DISPLAY_HEIGHT - (TETRIS_BLOCK_SIZE - 1) - (y_offset + map_y*TETRIS_BLOCK_SIZE),
-                        TETRIS_BLOCK_SIZE, 4*TETRIS_BLOCK_SIZE);
-                    break;
-            } break;
+            u8g2_DrawBox(&u8g2, preview_x + 4, preview_y + 4, 8, 2);
+            break;
     }
 }
 
-void tetris_draw_background(int score, short int speed, short int next_id)
+void tetris_draw_background(int score, short int speed, const tetris_queue* queue)
 {
     u8g2_SetFont(&u8g2, u8g2_font_4x6_tf);
 
@@ -361,514 +400,90 @@ void tetris_draw_background(int score, short int speed, short int next_id)
     u8g2_DrawStr(&u8g2, ui_x + 19 - speed_width - 2, y + 1, buf);
     y += 17;
 
-    // --- NEXT Block ---
+    // --- NEXT Blocks ---
+    //the next piece sits under the speed and the ones after it to its left, away from the board
     u8g2_DrawStr(&u8g2, ui_x + 3, y, "NEXT");
     y += 2;
-    int preview_x = ui_x + 2;
-    int preview_y = y;
-    u8g2_DrawFrame(&u8g2, preview_x - 1, preview_y - 1, 18, 12);
-    switch(next_id)
-    {
-        case 0: //single block
-            u8g2_DrawBox(&u8g2, preview_x + 7, preview_y + 4, 2, 2);
-            break;
-
-        case 1: //2x2 block
-            u8g2_DrawBox(&u8g2, preview_x + 6, preview_y + 3, 4, 4);
-            break;
-
-        case 2: //small L block
-            u8g2_DrawBox(&u8g2, preview_x + 6, preview_y + 3, 2, 4);
-            u8g2_DrawBox(&u8g2, preview_x + 8, preview_y + 5, 2, 2);
-            break;
-
-        case 3: //t block
-            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 3, 6, 2);
-            u8g2_DrawBox(&u8g2, preview_x + 7, preview_y + 5, 2, 2);
-            break;
-
-        case 4: //z block
-            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 3, 4, 2);
-            u8g2_DrawBox(&u8g2, preview_x + 7, preview_y + 5, 4, 2);
-            break;
-
-        case 5: //reverse z block
-            u8g2_DrawBox(&u8g2, preview_x + 7, preview_y + 3, 4, 2);
-            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 5, 4, 2);
-            break;
-
-        case 6: //L block
-            u8g2_DrawBox(&u8g2, preview_x + 9, preview_y + 3, 2, 2);
-            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 5, 6, 2);
-            break;
-
-        case 7: //reverse L block
-            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 3, 2, 2);
-            u8g2_DrawBox(&u8g2, preview_x + 5, preview_y + 5, 6, 2);
-            break;
-
-        case 8: //4x1 long block
-            u8g2_DrawBox(&u8g2, preview_x + 4, preview_y + 4, 8, 2);
-            break;
-    }
+    for(short int n = 0; n < TETRIS_PREVIEWS; n++)
+        tetris_draw_preview(tetris_peek_piece(queue, n), ui_x + 2 - n*20, y);
 }
 
-void tetris_draw_row_deletion(short int row, short int count, int score, short int speed, short int next_id)
+//one step of the clear animation, wipes the next two columns of the rows from the middle outward
+void tetris_wipe_rows(uint32_t rows, short int step)
 {
-    if(row == -1)
-        return;
-
-    for(int i = 0; i < TETRIS_MAP_WIDTH/2; i++)
-    {
-        for(int j = 0; j < count; j++)
-        {
-            tetris_map[row + j][TETRIS_MAP_WIDTH/2 + i] = false;
-            tetris_map[row + j][TETRIS_MAP_WIDTH/2 - 1 - i] = false;
-        }
-        u8g2_ClearBuffer(&u8g2);
-        tetris_draw_background(score, speed, next_id);
-        tetris_draw_frame();
-        tetris_draw_blocks();
-        u8g2_SendBuffer(&u8g2);
-    }
-
-    tetris_shift_rows_down(row, count);
-    u8g2_ClearBuffer(&u8g2);
-    tetris_draw_background(score, speed, next_id);
-    tetris_draw_frame();
-    tetris_draw_blocks();
-    u8g2_SendBuffer(&u8g2);
+    uint16_t wiped = TETRIS_CELL(TETRIS_MAP_WIDTH/2 + step) | TETRIS_CELL(TETRIS_MAP_WIDTH/2 - 1 - step);
+    for(short int row = 0; row < TETRIS_MAP_HEIGHT; row++)
+        if(rows & (1u << row))
+            tetris_rows[row] &= ~wiped;
 }
 
+//a piece reaches from map_y - 3 to map_y and from map_x - 1 to map_x + 2, positions further out
+//could not fit anyway and would shift the piece rows past the board words
 bool tetris_block_fits(short int map_x, short int map_y, short int id, block_rotation rotation)
 {
-    switch(id)
-    {
-        case 0: //signle block
-            if(map_x >= TETRIS_MAP_WIDTH || map_x < 0 || map_y < 0)
-                return false;
-            if(tetris_map[map_y][map_x])
-                return false;
-            break;
-
-        case 1: //2x2 block
-            if((map_x + 1) >= TETRIS_MAP_WIDTH || map_x < 0 || (map_y - 1) < 0)
-                return false;
-            if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x + 1] ||
-                tetris_map[map_y - 1][map_x] || tetris_map[map_y][map_x + 1])
-                return false;
-            break;
-
-        case 2: //small L block
-            if((map_x + 1) >= TETRIS_MAP_WIDTH || map_x < 0 || (map_y - 1) < 0)
-                return false;
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x + 1] || tetris_map[map_y - 1][map_x])
-                        return false;
-                    break;
-                case RIGHT_90:
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x] || tetris_map[map_y][map_x + 1])
-                        return false;
-                    break;
-                case UPSIDE_DOWN:
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x + 1] || tetris_map[map_y][map_x + 1])
-                        return false;
-                    break;
-                case LEFT_90:
-                    if(tetris_map[map_y - 1][map_x + 1] || tetris_map[map_y - 1][map_x] || tetris_map[map_y][map_x + 1])
-                        return false;
-                    break;
-            }
-            break;
-
-        case 3: //t block
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || (map_y - 1) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x] ||
-                        tetris_map[map_y][map_x + 1] || tetris_map[map_y][map_x - 1])
-                        return false;
-                    break;
-                case RIGHT_90:
-                    if(map_x >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || (map_y - 2) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x] ||
-                        tetris_map[map_y - 2][map_x] || tetris_map[map_y - 1][map_x - 1])
-                        return false;
-                    break;
-                case UPSIDE_DOWN:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || (map_y - 1) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x] ||
-                        tetris_map[map_y - 1][map_x + 1] || tetris_map[map_y - 1][map_x - 1])
-                        return false;
-                    break;
-                case LEFT_90:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || map_x < 0 || (map_y - 2) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x] ||
-                        tetris_map[map_y - 2][map_x] || tetris_map[map_y - 1][map_x + 1])
-                        return false;
-                    break;
-            }
-            break;
-
-        case 4: //z block
-            switch (rotation)
-            {
-                case NO_ROTATION:
-                case UPSIDE_DOWN:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || (map_y - 1) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x - 1] || tetris_map[map_y][map_x] ||
-                        tetris_map[map_y - 1][map_x] || tetris_map[map_y - 1][map_x + 1])
-                        return false;
-                    break;
-                case RIGHT_90:
-                case LEFT_90:
-                    if(map_x >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || (map_y - 2) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x] ||
-                        tetris_map[map_y - 1][map_x - 1] || tetris_map[map_y - 2][map_x - 1])
-                        return false;
-                    break;
-            } break;
-
-        case 5: //reverse z block
-            switch (rotation)
-            {
-                case NO_ROTATION:
-                case UPSIDE_DOWN:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || (map_y - 1) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x + 1] || tetris_map[map_y][map_x] ||
-                        tetris_map[map_y - 1][map_x] || tetris_map[map_y - 1][map_x - 1])
-                        return false;
-                    break;
-                case RIGHT_90:
-                case LEFT_90:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || map_x < 0 || (map_y - 2) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x] ||
-                        tetris_map[map_y - 1][map_x + 1] || tetris_map[map_y - 2][map_x + 1])
-                        return false;
-                    break;
-            } break;
-
-        case 6: //L block
-            switch (rotation)
-            {
-                case NO_ROTATION:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || (map_y - 1) < 0)
-                        return false;
-                    if(tetris_map[map_y - 1][map_x - 1] || tetris_map[map_y - 1][map_x + 1] ||
-                        tetris_map[map_y - 1][map_x] || tetris_map[map_y][map_x + 1])
-                        return false;
-                    break;
-                case RIGHT_90:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || map_x < 0 || (map_y - 2) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 2][map_x + 1] ||
-                        tetris_map[map_y - 1][map_x] || tetris_map[map_y - 2][map_x])
-                        return false;
-                    break;
-                case UPSIDE_DOWN:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || (map_y - 1) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x - 1] || tetris_map[map_y][map_x] ||
-                        tetris_map[map_y][map_x + 1] || tetris_map[map_y - 1][map_x - 1])
-                        return false;
-                    break;
-                case LEFT_90:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || map_x < 0 || (map_y - 2) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x + 1] || tetris_map[map_y - 1][map_x + 1] ||
-                        tetris_map[map_y - 2][map_x + 1] || tetris_map[map_y][map_x])
-                        return false;
-                    break;
-            } break;
-
-        case 7: //reverse L block
-            switch (rotation)
-            {
-                case NO_ROTATION:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || (map_y - 1) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x - 1] || tetris_map[map_y - 1][map_x - 1] ||
-                        tetris_map[map_y - 1][map_x] || tetris_map[map_y - 1][map_x + 1])
-                        return false;
-                    break;
-                case RIGHT_90:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || map_x < 0 || (map_y - 2) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y][map_x + 1] ||
-                        tetris_map[map_y - 1][map_x] || tetris_map[map_y - 2][map_x])
-                        return false;
-                    break;
-                case UPSIDE_DOWN:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || (map_y - 1) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x - 1] || tetris_map[map_y][map_x] ||
-                        tetris_map[map_y][map_x + 1] || tetris_map[map_y - 1][map_x + 1])
-                        return false;
-                    break;
-                case LEFT_90:
-                    if((map_x + 1) >= TETRIS_MAP_WIDTH || map_x < 0 || (map_y - 2) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x + 1] || tetris_map[map_y - 1][map_x + 1] ||
-                        tetris_map[map_y - 2][map_x] || tetris_map[map_y - 2][map_x + 1])
-                        return false;
-                    break;
-            } break;
-
-        case 8: //4x1 long block
-            switch (rotation)
-            {
-                case NO_ROTATION:
-                case UPSIDE_DOWN:
-                    if((map_x + 2) >= TETRIS_MAP_WIDTH || (map_x - 1) < 0 || map_y < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x - 1] || tetris_map[map_y][map_x] ||
-                        tetris_map[map_y][map_x + 1] || tetris_map[map_y][map_x + 2])
-                        return false;
-                    break;
-                case RIGHT_90:
-                case LEFT_90:
-                    if(map_x >= TETRIS_MAP_WIDTH || map_x < 0 || (map_y - 3) < 0)
-                        return false;
-                    if(tetris_map[map_y][map_x] || tetris_map[map_y - 1][map_x] ||
-                        tetris_map[map_y - 2][map_x] || tetris_map[map_y - 3][map_x])
-                        return false;
-                    break;
-            } break;
-    }
-    return true;
+    if(map_x < -1 || map_x > TETRIS_MAP_WIDTH || map_y < 0 || map_y >= TETRIS_MAP_HEIGHT)
+        return false;
+    const uint8_t* piece = tetris_pieces[id][rotation];
+    short int shift = map_x - 1 + TETRIS_WALL_BITS;
+    return !((tetris_rows[map_y] & piece[0] << shift) | (tetris_rows[map_y - 1] & piece[1] << shift) |
+        (tetris_rows[map_y - 2] & piece[2] << shift) | (tetris_rows[map_y - 3] & piece[3] << shift));
 }
 
+//locks the piece into the board, it must fit there
 void tetris_deactivate_block(short int map_x, short int map_y, short int id, block_rotation rotation)
 {
-    switch(id)
-    {
-        case 0: //single block
-            tetris_map[map_y][map_x] = true;
-            break;
-
-        case 1: //2x2 block
-            tetris_map[map_y][map_x] = true;
-            tetris_map[map_y][map_x + 1] = true;
-            tetris_map[map_y - 1][map_x] = true;
-            tetris_map[map_y - 1][map_x + 1] = true;
-            break;
-
-        case 2: //small L block
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    break;
-                case RIGHT_90:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    break;
-                case UPSIDE_DOWN:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    break;
-                case LEFT_90:
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    break;
-            } break;
-
-        case 3: //t block
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y][map_x - 1] = true;
-                    break;
-                case RIGHT_90:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y - 2][map_x] = true;
-                    tetris_map[map_y - 1][map_x - 1] = true;
-                    break;
-                case UPSIDE_DOWN:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x - 1] = true;
-                    break;
-                case LEFT_90:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y - 2][map_x] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    break;
-            } break;
-        
-        case 4: //z block
-            tetris_map[map_y][map_x] = true;
-            tetris_map[map_y - 1][map_x] = true;
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                case UPSIDE_DOWN:
-                    tetris_map[map_y][map_x - 1] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    break;
-                case RIGHT_90:
-                case LEFT_90:
-                    tetris_map[map_y - 1][map_x - 1] = true;
-                    tetris_map[map_y - 2][map_x - 1] = true;
-                    break;
-            } break;
-
-        case 5: //reverse z block
-            tetris_map[map_y][map_x] = true;
-            tetris_map[map_y - 1][map_x] = true;
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                case UPSIDE_DOWN:
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x - 1] = true;
-                    break;
-                case RIGHT_90:
-                case LEFT_90:
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    tetris_map[map_y - 2][map_x + 1] = true;
-                    break;
-            } break;
-        
-        case 6: //L block
-            switch(rotation)
+    const uint8_t* piece = tetris_pieces[id][rotation];
+    short int shift = map_x - 1 + TETRIS_WALL_BITS;
+    tetris_rows[map_y] |= piece[0] << shift;
+    tetris_rows[map_y - 1] |= piece[1] << shift;
+    tetris_rows[map_y - 2] |= piece[2] << shift;
+    tetris_rows[map_y - 3] |= piece[3] << shift;
+
+    //the top cell of a piece column is its first row from the top that has the cell
+    for(short int i = 0; i < 4; i++)
+        for(short int k = 0; k < 4; k++)
+            if(piece[k] & (1 << i))
             {
-                case NO_ROTATION:
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x - 1] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    break;
-                case RIGHT_90:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y - 2][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y - 2][map_x] = true;
-                    break;
-                case UPSIDE_DOWN:
-                    tetris_map[map_y][map_x - 1] = true;
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x - 1] = true;
-                    break;
-                case LEFT_90:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    tetris_map[map_y - 2][map_x + 1] = true;
-                    break;
-            } break;
-
-        case 7: //reverse L block
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                    tetris_map[map_y][map_x - 1] = true;
-                    tetris_map[map_y - 1][map_x - 1] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    break;
-                case RIGHT_90:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y - 2][map_x] = true;
-                    break;
-                case UPSIDE_DOWN:
-                    tetris_map[map_y][map_x - 1] = true;
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    break;
-                case LEFT_90:
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y - 1][map_x + 1] = true;
-                    tetris_map[map_y - 2][map_x] = true;
-                    tetris_map[map_y - 2][map_x + 1] = true;
-                    break;
-            } break;
-
-        case 8: //4x1 long block
-            switch(rotation)
-            {
-                case NO_ROTATION:
-                case UPSIDE_DOWN:
-                    tetris_map[map_y][map_x - 1] = true;
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y][map_x + 1] = true;
-                    tetris_map[map_y][map_x + 2] = true;
-                    break;
-                case RIGHT_90:
-                case LEFT_90:
-                    tetris_map[map_y][map_x] = true;
-                    tetris_map[map_y - 1][map_x] = true;
-                    tetris_map[map_y - 2][map_x] = true;
-                    tetris_map[map_y - 3][map_x] = true;
-                    break;
-            } break;
-    }
+                if(tetris_heights[map_x - 1 + i] < map_y - k + 1)
+                    tetris_heights[map_x - 1 + i] = map_y - k + 1;
+                break;
+            }
 }
 
-int tetris_check_row_completion(short int* score_multiplier, int score, short int speed, short int next_id)
+//the lowest row the piece drops to from where it is, each column of the piece rests its bottom cell
+//on the height of the board column below it, only a piece that slid under an overhang has to probe
+short int tetris_landing_row(short int map_x, short int map_y, short int id, block_rotation rotation)
 {
-    short int consecutive_rows = 1;
-    short int starting_row = -1;
-    bool completed_row;
-    for(int row = 0; row < TETRIS_MAP_HEIGHT; row++)
-    {
-        completed_row = 1;
-        for(int col = 0; col < TETRIS_MAP_WIDTH; col++)
-        {
-            if(!tetris_map[row][col])
+    const uint8_t* piece = tetris_pieces[id][rotation];
+    short int landing = 0;
+    for(short int i = 0; i < 4; i++)
+        for(short int k = 3; k >= 0; k--)
+            if(piece[k] & (1 << i))
             {
-                completed_row = 0;
+                if(tetris_heights[map_x - 1 + i] + k > landing)
+                    landing = tetris_heights[map_x - 1 + i] + k;
                 break;
             }
-        }
+    if(landing <= map_y)
+        return landing;
 
-        if(starting_row != -1)
-        {
-            if(completed_row)
-                consecutive_rows += 1;
-            else
-                break;
-        }
-        else if(completed_row)
-            starting_row = row;
-    }
+    while(tetris_block_fits(map_x, map_y - 1, id, rotation))
+        map_y--;
+    return map_y;
+}
 
-    tetris_draw_row_deletion(starting_row, consecutive_rows, score, speed, next_id);
-    
-    if(starting_row == -1)
+//points for clearing the rows in the mask, consecutive clears raise the multiplier and a piece
+//that clears nothing resets it
+int tetris_row_points(short int* score_multiplier, uint32_t rows)
+{
+    if(rows == 0)
     {
         *score_multiplier = 0;
         return 0;
     }
 
     (*score_multiplier)++;
-    switch(consecutive_rows)
+    switch(__builtin_popcount(rows))
     {
         case 1:
             return (*score_multiplier) * 100;
@@ -886,57 +501,107 @@ void tetris_run()
 {
     int score, speed_limit;
     short int block_id, block_x, block_y;
-    short int next_id, next_x, next_y;
+    short int next_x, next_y;
     short int speed, ticks_till_fall, score_multiplier;
     block_rotation rotation, next_rotation;
+    game_clock loop;
+    input_event event;
+    int64_t repeat_from, down_tap_until;
+    bool hard_drop;
+    uint32_t clearing_rows;
+    short int clear_step;
 
     while(true)
     {
         //initialize variables
         score = 0, speed = 1, speed_limit = 2000, score_multiplier = 0;
+        clearing_rows = 0, clear_step = 0;
         ticks_till_fall = TETRIS_MAX_SPEED + 1 - speed;
-        block_id = rand() % TETRIS_NUMBER_OF_BLOCKS;
-        next_id = rand() % TETRIS_NUMBER_OF_BLOCKS;
+        tetris_queue_reset(&tetris_upcoming, rand());
+        block_id = tetris_next_piece(&tetris_upcoming);
         block_x = TETRIS_MAP_WIDTH / 2 - 1;
         block_y = TETRIS_MAP_HEIGHT - 1;
         rotation = NO_ROTATION;
         next_x = block_x, next_y = block_y, next_rotation = rotation;
-        memset(tetris_map, 0, sizeof(tetris_map));
+        tetris_clear_board();
         
         tetris_start_screen();
 
         //wait for button press to start the game
-        esp_light_sleep_start();
+        input_sleep_until_press();
+        repeat_from = INT64_MAX, down_tap_until = 0, hard_drop = false;
+        game_clock_start(&loop, "tetris", TETRIS_TICK_MS);
 
         //main game loop
         while(true)
         {
             u8g2_ClearBuffer(&u8g2);
 
-            //process user inupt
-            if(gpio_get_level(DOWN_BUTTON))
-                next_y = block_y - 1;
-            if(gpio_get_level(LEFT_BUTTON))
-                next_x = block_x - 1;
-            if(gpio_get_level(RIGHT_BUTTON))
-                next_x = block_x + 1;
-            if(gpio_get_level(UP_BUTTON))
-                switch(rotation)
+            //process user inupt, presses act once and held left/right repeat after a delay, while
+            //rows are being cleared the presses stay queued for the next piece
+            PROFILE_BEGIN(PROFILE_INPUT);
+            while(clearing_rows == 0 && input_poll(&event))
+            {
+                if(!event.pressed)
+                    continue;
+                if(event.button == INPUT_DOWN)
+                {
+                    next_y = block_y - 1;
+                    if(event.time_us < down_tap_until)
+                        hard_drop = true, down_tap_until = 0;
+                    else
+                        down_tap_until = event.time_us + TETRIS_DOUBLE_TAP_US;
+                }
+                if(event.button == INPUT_LEFT)
+                    next_x = block_x - 1;
+                if(event.button == INPUT_RIGHT)
+                    next_x = block_x + 1;
+                if(event.button == INPUT_LEFT || event.button == INPUT_RIGHT)
+                    repeat_from = event.time_us + TETRIS_REPEAT_DELAY_US;
+                if(event.button == INPUT_UP)
+                    switch(rotation)
+                    {
+                        case NO_ROTATION:
+                            next_rotation = RIGHT_90; break;
+                        case RIGHT_90:
+                            next_rotation = UPSIDE_DOWN; break;
+                        case UPSIDE_DOWN:
+                            next_rotation = LEFT_90; break;
+                        case LEFT_90:
+                            next_rotation = NO_ROTATION; break;
+                    }
+            }
+            if(clearing_rows == 0)
+            {
+                if(input_held(INPUT_DOWN))
+                    next_y = block_y - 1;
+                if(esp_timer_get_time() >= repeat_from)
+                {
+                    if(input_held(INPUT_LEFT))
+                        next_x = block_x - 1;
+                    if(input_held(INPUT_RIGHT))
+                        next_x = block_x + 1;
+                }
+            }
+            PROFILE_END(PROFILE_INPUT);
+
+            PROFILE_BEGIN(PROFILE_UPDATE);
+            //the clear animation wipes one step per tick, then the rows drop and score
+            if(clearing_rows != 0)
+            {
+                if(clear_step < TETRIS_MAP_WIDTH/2)
+                    tetris_wipe_rows(clearing_rows, clear_step++);
+                else
                 {
-                    case NO_ROTATION:
-                        next_rotation = RIGHT_90; break;
-                    case RIGHT_90:
-                        next_rotation = UPSIDE_DOWN; break;
-                    case UPSIDE_DOWN:
-                        next_rotation = LEFT_90; break;
-                    case LEFT_90:
-                        next_rotation = NO_ROTATION; break;
+                    tetris_clear_rows(clearing_rows);
+                    score += tetris_row_points(&score_multiplier, clearing_rows);
+                    clearing_rows = 0;
                 }
+            }
 
-            if(block_id == -1)
+            if(block_id == -1 && clearing_rows == 0)
             {
-                block_id = next_id;
-                next_id = rand() % TETRIS_NUMBER_OF_BLOCKS;
+                block_id = tetris_next_piece(&tetris_upcoming);
                 block_x = TETRIS_MAP_WIDTH / 2 - 1;
                 block_y = TETRIS_MAP_HEIGHT - 1;
                 rotation = NO_ROTATION;
@@ -947,67 +612,89 @@ void tetris_run()
                 }
             }
 
-            ticks_till_fall--;
-            if(ticks_till_fall == 0)
+            if(block_id != -1)
             {
-                if(score >= speed_limit && speed_limit != -1)
+                ticks_till_fall--;
+                if(ticks_till_fall == 0)
                 {
-                    speed++;
-                    switch(speed)
+                    if(score >= speed_limit && speed_limit != -1)
                     {
-                        case 2:
-                            speed_limit = 4000; break;
-                        case 3:
-                            speed_limit = 10000; break;
-                        case 4:
-                            speed_limit = 20000; break;
-                        case 5:
-                            speed_limit = -1; break;
+                        speed++;
+                        switch(speed)
+                        {
+                            case 2:
+                                speed_limit = 4000; break;
+                            case 3:
+                                speed_limit = 10000; break;
+                            case 4:
+                                speed_limit = 20000; break;
+                            case 5:
+                                speed_limit = -1; break;
+                        }
                     }
+                    ticks_till_fall = TETRIS_MAX_SPEED + 1 - speed;
+                    if(next_y == block_y)
+                        next_y--;
                 }
-                ticks_till_fall = TETRIS_MAX_SPEED + 1 - speed;
-                if(next_y == block_y)
-                    next_y--;
-            }
 
-            if(next_x != block_x)
-                if(tetris_block_fits(next_x, block_y, block_id, rotation))
-                    block_x = next_x;
-            if(next_rotation != rotation)
-                if(tetris_block_fits(block_x, block_y, block_id, next_rotation))
-                    rotation = next_rotation;
-            if(next_y < block_y)
-            {
-                if(tetris_block_fits(block_x, next_y, block_id, rotation))
-                    block_y = next_y;
-                else
+                if(next_x != block_x)
+                    if(tetris_block_fits(next_x, block_y, block_id, rotation))
+                        block_x = next_x;
+                if(next_rotation != rotation)
+                    if(tetris_block_fits(block_x, block_y, block_id, next_rotation))
+                        rotation = next_rotation;
+                if(hard_drop)
                 {
-                    tetris_deactivate_block(block_x, block_y, block_id, rotation);
-                    block_y = -1, block_x = -1, block_id = -1;
-                    next_x = -1, next_y = -1;
+                    block_y = tetris_landing_row(block_x, block_y, block_id, rotation);
+                    next_y = block_y - 1;
+                    hard_drop = false;
                 }
+                if(next_y < block_y)
+                {
+                    if(tetris_block_fits(block_x, next_y, block_id, rotation))
+                        block_y = next_y;
+                    else
+                    {
+                        //lock the piece and start clearing whatever rows it completed
+                        tetris_deactivate_block(block_x, block_y, block_id, rotation);
+                        block_y = -1, block_x = -1, block_id = -1;
+                        next_x = -1, next_y = -1;
+                        down_tap_until = 0;
+                        clearing_rows = tetris_full_rows();
+                        clear_step = 0;
+                        if(clearing_rows == 0)
+                            tetris_row_points(&score_multiplier, 0);
+                    }
+                }
+                //rollback all unsuccessful states
+                next_x = block_x, next_y = block_y, next_rotation = rotation;
             }
-            //rollback all unsuccessful states
-            next_x = block_x, next_y = block_y, next_rotation = rotation;
+            PROFILE_END(PROFILE_UPDATE);
 
             //render eveything
+            PROFILE_BEGIN(PROFILE_DRAW);
+            if(block_id != -1)
+                tetris_draw_ghost_block(block_x, tetris_landing_row(block_x, block_y, block_id, rotation),
+                    block_id, rotation);
             tetris_draw_active_block(block_x, block_y, block_id, rotation);
-            tetris_draw_background(score, speed, next_id);
+            tetris_draw_background(score, speed, &tetris_upcoming);
             tetris_draw_frame();
             tetris_draw_blocks();
-            u8g2_SendBuffer(&u8g2);
+            PROFILE_FRAME();
+            PROFILE_END(PROFILE_DRAW);
+
+            PROFILE_BEGIN(PROFILE_FLUSH);
+            display_flush();
+            PROFILE_END(PROFILE_FLUSH);
 
-            //check for completed rows
-            if(block_id == -1)
-                score += tetris_check_row_completion(&score_multiplier, score, speed, next_id);
-            
+            game_clock_wait(&loop);
         }
+        game_clock_report(&loop);
 
         tetris_end_screen(score);
 
         //wait for exit the game or play again button press
-        esp_light_sleep_start();
-        if(!gpio_get_level(LEFT_BUTTON))
+        if(!(input_sleep_until_press() & INPUT_MASK(INPUT_LEFT)))
             break;
     }
 }
@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "globals.h"
+#include "display.h"
+#include "../games/snake.h"
+#include "../games/tetris.h"
+#include "../games/flappy_bird.h"
+#include "sim.h"
+
+//micro benchmarks for the game hot paths, every case runs until it took BENCH_MIN_NS and
+//reports the average time and heap allocations per call
+#define BENCH_MIN_NS  50000000ULL
+
+u8g2_t u8g2;
+u8g2_esp32_hal_t u8g2_esp32_hal = U8G2_ESP32_HAL_DEFAULT;
+int snake_highscore = 0;
+int tetris_highscore = 0;
+int flappy_bird_highscore = 0;
+
+//------------------------------------ allocations -------------------------------------------------
+//the benchmark is linked with --wrap for these, so every heap allocation passes through here
+static uint64_t bench_allocations = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    bench_allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    bench_allocations++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size)
+{
+    bench_allocations++;
+    return __real_realloc(pointer, size);
+}
+
+//--------------------------------------- harness --------------------------------------------------
+typedef struct bench_case
+{
+    const char* name;
+    const char* state;
+    void (*setup)(void);     //builds the board state once
+    void (*op)(void);        //the measured call
+    void (*reset)(void);     //restores state an op mutates, its cost is measured and subtracted
+} bench_case;
+
+static volatile int bench_sink;
+static uint32_t bench_counter = 0;
+
+static uint64_t bench_now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static uint64_t bench_loop(const bench_case* test, bool run_op, uint64_t iterations, uint64_t* allocations)
+{
+    uint64_t allocations_before = bench_allocations;
+    uint64_t start = bench_now_ns();
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        if(test->reset)
+            test->reset();
+        if(run_op)
+            test->op();
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    *allocations = bench_allocations - allocations_before;
+    return elapsed;
+}
+
+static void bench_run(const bench_case* test)
+{
+    uint64_t allocations, reset_allocations = 0;
+    uint64_t iterations = 1;
+    test->setup();
+    bench_counter = 0;
+    while(bench_loop(test, true, iterations, &allocations) < BENCH_MIN_NS / 10)
+        iterations *= 2;
+    iterations *= 10;
+
+    uint64_t elapsed = bench_loop(test, true, iterations, &allocations);
+    if(test->reset)
+    {
+        uint64_t reset_elapsed = bench_loop(test, false, iterations, &reset_allocations);
+        elapsed = elapsed > reset_elapsed ? elapsed - reset_elapsed : 0;
+        allocations = allocations > reset_allocations ? allocations - reset_allocations : 0;
+    }
+
+    printf("%-30s %-12s %12.1f %10.2f %12llu\n", test->name, test->state,
+        (double)elapsed / iterations, (double)allocations / iterations, (unsigned long long)iterations);
+}
+
+//---------------------------------------- snake ---------------------------------------------------
+static snake_state bench_snake;
+static direction bench_snake_direction;
+
+//lays a snake of the given length along a serpentine from the bottom left corner
+static void bench_snake_build(short int length)
+{
+    snake_board_clear(&bench_snake.map);
+    snake_body_clear(&bench_snake.body);
+    bench_snake.camera_x = 0, bench_snake.camera_y = 0;
+
+    short int older_x = 0, older_y = 0;
+    for(short int k = 0; k < length; k++)
+    {
+        short int y = k / MAP_WIDTH;
+        short int x = y % 2 ? MAP_WIDTH - 1 - k % MAP_WIDTH : k % MAP_WIDTH;
+        direction next_direction;
+        if(k == 0)
+            next_direction = LEFT;
+        else if(older_y != y)
+            next_direction = DOWN;
+        else
+            next_direction = older_x < x ? LEFT : RIGHT;
+        snake_push_head(&bench_snake.body, SNAKE_SEGMENT(y * MAP_WIDTH + x, next_direction, k % 7 == 0));
+        snake_occupy_cell(&bench_snake.map, x, y);
+        older_x = x;
+        older_y = y;
+    }
+    bench_snake_direction = (SNAKE_SEGMENT_DIRECTION(snake_head(&bench_snake.body)) + 2) % 4;
+    bench_snake.seed = 1;
+    snake_generate_apple(&bench_snake);
+}
+
+static void bench_snake_short() { bench_snake_build(4); }
+static void bench_snake_half() { bench_snake_build(MAP_WIDTH * MAP_HEIGHT / 2); }
+static void bench_snake_full() { bench_snake_build(MAP_WIDTH * MAP_HEIGHT - 10); }
+
+static void bench_snake_collision_check()
+{
+    bench_sink = snake_collision_check(&bench_snake, bench_counter++ % 4);
+}
+
+//one move without eating: push the new head and drop the tail
+static void bench_snake_step()
+{
+    snake_add_segment(&bench_snake, bench_snake_direction);
+    snake_pop_last_segment(&bench_snake);
+}
+
+//the apple is put back so the draw cases of the same setup still find it
+static void bench_snake_generate_apple()
+{
+    short int apple_x = bench_snake.apple_x, apple_y = bench_snake.apple_y;
+    snake_generate_apple(&bench_snake);
+    bench_sink = bench_snake.apple_x + bench_snake.apple_y;
+    bench_snake.apple_x = apple_x, bench_snake.apple_y = apple_y;
+}
+
+static void bench_snake_generate_animal()
+{
+    snake_generate_animal(&bench_snake);
+    bench_sink = bench_snake.animal_x + bench_snake.animal_y;
+}
+
+static void bench_snake_draw()
+{
+    u8g2_ClearBuffer(&u8g2);
+    snake_draw_view(&bench_snake);
+    snake_draw_frame();
+    snake_draw_score(1234);
+    snake_draw_apple(&bench_snake, bench_snake.apple_x, bench_snake.apple_y);
+}
+
+static void bench_snake_autopilot()
+{
+    bench_sink = snake_autopilot(&bench_snake, bench_snake_direction);
+}
+
+//plays whole games with the autopilot and no rendering, to see how long it survives
+#define BENCH_AUTOPILOT_GAMES      50
+#define BENCH_AUTOPILOT_MAX_TICKS  20000
+
+static void bench_autopilot_games()
+{
+    static snake_state game;
+    uint64_t ticks = 0, apples = 0, ns = 0;
+    int capped = 0;
+    for(int seed = 1; seed <= BENCH_AUTOPILOT_GAMES; seed++)
+    {
+        snake_reset(&game, seed, true, false);
+        int tick = 0;
+        for(; tick < BENCH_AUTOPILOT_MAX_TICKS; tick++)
+        {
+            uint64_t start = bench_now_ns();
+            direction turn = snake_autopilot(&game, game.snake_direction);
+            ns += bench_now_ns() - start;
+            if(!snake_step(&game, turn))
+                break;
+        }
+        ticks += tick + (tick < BENCH_AUTOPILOT_MAX_TICKS);
+        apples += game.body.length - 4;
+        capped += tick == BENCH_AUTOPILOT_MAX_TICKS;
+    }
+    printf("\nsnake autopilot on %dx%d: %d games, %.0f ticks and %.1f apples per game (%d hit the %d tick cap), "
+        "%.0f decisions/s\n", MAP_WIDTH, MAP_HEIGHT, BENCH_AUTOPILOT_GAMES, (double)ticks / BENCH_AUTOPILOT_GAMES,
+        (double)apples / BENCH_AUTOPILOT_GAMES, capped, BENCH_AUTOPILOT_MAX_TICKS, ticks * 1e9 / ns);
+}
+
+//what a tick redraws with the retained buffer, independent of the snake length
+static void bench_snake_patch()
+{
+    snake_draw_segment(&bench_snake, 0);
+    snake_draw_segment(&bench_snake, 1);
+    snake_draw_segment(&bench_snake, bench_snake.body.length - 1);
+    snake_clear_hud();
+    snake_draw_score(1234);
+    snake_draw_apple(&bench_snake, bench_snake.apple_x, bench_snake.apple_y);
+}
+
+//one of the frames between two ticks, the head and the tail slide a pixel further
+static void bench_snake_slide()
+{
+    snake_segment tail = snake_segment_at(&bench_snake.body, bench_snake.body.length - 1);
+    snake_draw_motion(&bench_snake, tail, true, 1 + bench_counter++ % 3,
+        snake_head_tiles[SNAKE_SEGMENT_DIRECTION(snake_head(&bench_snake.body))][0]);
+    snake_draw_apple(&bench_snake, bench_snake.apple_x, bench_snake.apple_y);
+}
+
+//---------------------------------------- tetris --------------------------------------------------
+static uint16_t bench_tetris_saved[sizeof(tetris_board) / sizeof(tetris_board[0])];
+static short int bench_score_multiplier;
+
+//fills the bottom rows with one hole each, the topmost completed of them without a hole
+static void bench_tetris_build(short int rows, short int completed)
+{
+    tetris_clear_board();
+    for(short int row = 0; row < rows; row++)
+        tetris_rows[row] = TETRIS_FULL_ROW & ~TETRIS_CELL((row * 3) % TETRIS_MAP_WIDTH);
+    for(short int row = rows - completed; row < rows; row++)
+        tetris_rows[row] = TETRIS_FULL_ROW;
+    tetris_update_heights();
+    tetris_queue_reset(&tetris_upcoming, 1);
+    memcpy(bench_tetris_saved, tetris_board, sizeof(tetris_board));
+}
+
+static void bench_tetris_empty() { bench_tetris_build(0, 0); }
+static void bench_tetris_half() { bench_tetris_build(TETRIS_MAP_HEIGHT / 2, 0); }
+static void bench_tetris_full() { bench_tetris_build(TETRIS_MAP_HEIGHT - 2, 0); }
+static void bench_tetris_half_one_row() { bench_tetris_build(TETRIS_MAP_HEIGHT / 2, 1); }
+static void bench_tetris_full_four_rows() { bench_tetris_build(TETRIS_MAP_HEIGHT - 2, 4); }
+
+//two full rows with holed ones between them, all of them clear in the same pass
+static void bench_tetris_full_split_rows()
+{
+    bench_tetris_build(TETRIS_MAP_HEIGHT - 2, 0);
+    tetris_rows[4] = tetris_rows[7] = TETRIS_FULL_ROW;
+    memcpy(bench_tetris_saved, tetris_board, sizeof(tetris_board));
+}
+
+static void bench_tetris_reset()
+{
+    memcpy(tetris_board, bench_tetris_saved, sizeof(tetris_board));
+    bench_score_multiplier = 0;
+}
+
+static void bench_tetris_block_fits()
+{
+    uint32_t i = bench_counter++;
+    bench_sink = tetris_block_fits(i % TETRIS_MAP_WIDTH, (i / TETRIS_MAP_WIDTH) % TETRIS_MAP_HEIGHT,
+        (i / 200) % TETRIS_NUMBER_OF_BLOCKS, (i / 1800) % 4);
+}
+
+//the ghost piece query, from the top of the board like a freshly spawned piece
+static void bench_tetris_landing_row()
+{
+    uint32_t i = bench_counter++;
+    short int id = i % TETRIS_NUMBER_OF_BLOCKS;
+    bench_sink = tetris_landing_row(1 + (i / TETRIS_NUMBER_OF_BLOCKS) % (TETRIS_MAP_WIDTH - 3),
+        TETRIS_MAP_HEIGHT - 1, id, NO_ROTATION);
+}
+
+static void bench_tetris_next_piece()
+{
+    bench_sink = tetris_next_piece(&tetris_upcoming);
+}
+
+static void bench_tetris_row_clear()
+{
+    uint32_t rows = tetris_full_rows();
+    tetris_clear_rows(rows);
+    bench_sink = tetris_row_points(&bench_score_multiplier, rows);
+}
+
+static void bench_tetris_draw()
+{
+    u8g2_ClearBuffer(&u8g2);
+    tetris_draw_ghost_block(TETRIS_MAP_WIDTH / 2 - 1,
+        tetris_landing_row(TETRIS_MAP_WIDTH / 2 - 1, TETRIS_MAP_HEIGHT - 1, 6, RIGHT_90), 6, RIGHT_90);
+    tetris_draw_active_block(TETRIS_MAP_WIDTH / 2 - 1, TETRIS_MAP_HEIGHT - 1, 6, RIGHT_90);
+    tetris_draw_background(1234, 2, &tetris_upcoming);
+    tetris_draw_frame();
+    tetris_draw_blocks();
+}
+
+//--------------------------------------- flappy bird ----------------------------------------------
+static int bench_pipes[NumOfPipes + 1];
+
+static void bench_flappy_no_pipes()
+{
+    for(int i = 0; i < NumOfPipes + 1; i++)
+        bench_pipes[i] = -1;
+}
+
+static void bench_flappy_pipes()
+{
+    for(int i = 0; i < NumOfPipes + 1; i++)
+        bench_pipes[i] = 5 + i * 7;
+}
+
+static void bench_flappy_collision_check()
+{
+    uint32_t i = bench_counter++;
+    float height = i % SH;
+    float position = BirdPos - 12 + (i / SH) % 24;
+    float velocity = i % 2 ? 3.0f : -3.0f;
+    bench_sink = Collision_Check(height, position, bench_pipes[i % (NumOfPipes + 1)], velocity);
+}
+
+static void bench_flappy_draw()
+{
+    OLEDI2C_clrScr();
+    Draw_Bird_WingsUp(SH / 2);
+    for(int i = 0; i < NumOfPipes + 1; i++)
+        Draw_Pipe(SectionWidth / 2 + i * SectionWidth, bench_pipes[i]);
+}
+
+//---------------------------------------- display -------------------------------------------------
+static void bench_display_static()
+{
+    u8g2_ClearBuffer(&u8g2);
+    display_flush();
+}
+
+static void bench_display_flush()
+{
+    display_flush();
+}
+
+static void bench_display_invert()
+{
+    uint8_t* buffer = u8g2_GetBufferPtr(&u8g2);
+    memset(buffer, bench_counter++ % 2 ? 0x55 : 0xaa, DISPLAY_BUFFER_SIZE);
+}
+
+static const bench_case bench_cases[] =
+{
+    {"tetris_block_fits", "empty", bench_tetris_empty, bench_tetris_block_fits, NULL},
+    {"tetris_block_fits", "half", bench_tetris_half, bench_tetris_block_fits, NULL},
+    {"tetris_block_fits", "full", bench_tetris_full, bench_tetris_block_fits, NULL},
+    {"tetris_landing_row", "empty", bench_tetris_empty, bench_tetris_landing_row, NULL},
+    {"tetris_landing_row", "half", bench_tetris_half, bench_tetris_landing_row, NULL},
+    {"tetris_landing_row", "full", bench_tetris_full, bench_tetris_landing_row, NULL},
+    {"tetris_next_piece", "empty", bench_tetris_empty, bench_tetris_next_piece, NULL},
+    {"tetris_row_clear", "empty", bench_tetris_empty, bench_tetris_row_clear, bench_tetris_reset},
+    {"tetris_row_clear", "half+1", bench_tetris_half_one_row, bench_tetris_row_clear, bench_tetris_reset},
+    {"tetris_row_clear", "full+4", bench_tetris_full_four_rows, bench_tetris_row_clear, bench_tetris_reset},
+    {"tetris_row_clear", "full+2 split", bench_tetris_full_split_rows, bench_tetris_row_clear, bench_tetris_reset},
+    {"tetris draw frame", "empty", bench_tetris_empty, bench_tetris_draw, NULL},
+    {"tetris draw frame", "half", bench_tetris_half, bench_tetris_draw, NULL},
+    {"tetris draw frame", "full", bench_tetris_full, bench_tetris_draw, NULL},
+    {"snake_collision_check", "short", bench_snake_short, bench_snake_collision_check, NULL},
+    {"snake_collision_check", "half", bench_snake_half, bench_snake_collision_check, NULL},
+    {"snake_collision_check", "full", bench_snake_full, bench_snake_collision_check, NULL},
+    {"snake step", "short", bench_snake_short, bench_snake_step, NULL},
+    {"snake step", "half", bench_snake_half, bench_snake_step, NULL},
+    {"snake step", "full", bench_snake_full, bench_snake_step, NULL},
+    {"snake_autopilot", "short", bench_snake_short, bench_snake_autopilot, NULL},
+    {"snake_autopilot", "half", bench_snake_half, bench_snake_autopilot, NULL},
+    {"snake_autopilot", "full", bench_snake_full, bench_snake_autopilot, NULL},
+    {"snake_generate_apple", "short", bench_snake_short, bench_snake_generate_apple, NULL},
+    {"snake_generate_apple", "half", bench_snake_half, bench_snake_generate_apple, NULL},
+    {"snake_generate_apple", "full", bench_snake_full, bench_snake_generate_apple, NULL},
+    {"snake_generate_animal", "short", bench_snake_short, bench_snake_generate_animal, NULL},
+    {"snake_generate_animal", "half", bench_snake_half, bench_snake_generate_animal, NULL},
+    {"snake_generate_animal", "full", bench_snake_full, bench_snake_generate_animal, NULL},
+    {"snake draw frame", "short", bench_snake_short, bench_snake_draw, NULL},
+    {"snake draw frame", "half", bench_snake_half, bench_snake_draw, NULL},
+    {"snake draw frame", "full", bench_snake_full, bench_snake_draw, NULL},
+    {"snake patch frame", "short", bench_snake_short, bench_snake_patch, NULL},
+    {"snake patch frame", "half", bench_snake_half, bench_snake_patch, NULL},
+    {"snake patch frame", "full", bench_snake_full, bench_snake_patch, NULL},
+    {"snake slide frame", "short", bench_snake_short, bench_snake_slide, NULL},
+    {"snake slide frame", "full", bench_snake_full, bench_snake_slide, NULL},
+    {"Collision_Check", "no pipes", bench_flappy_no_pipes, bench_flappy_collision_check, NULL},
+    {"Collision_Check", "pipes", bench_flappy_pipes, bench_flappy_collision_check, NULL},
+    {"flappy draw frame", "no pipes", bench_flappy_no_pipes, bench_flappy_draw, NULL},
+    {"flappy draw frame", "pipes", bench_flappy_pipes, bench_flappy_draw, NULL},
+    {"display_flush", "unchanged", bench_display_static, bench_display_flush, NULL},
+    {"display_flush", "all tiles", bench_display_static, bench_display_flush, bench_display_invert},
+};
+
+int main(int argc, char** argv)
+{
+    sim_init();
+    init_display();
+    display_init();
+    snake_neighbors_init();
+    snake_atlas_init();
+
+    const char* filter = argc > 1 ? argv[1] : NULL;
+    printf("%-30s %-12s %12s %10s %12s\n", "case", "state", "ns/op", "allocs/op", "iterations");
+    for(size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++)
+        if(!filter || strstr(bench_cases[i].name, filter))
+            bench_run(&bench_cases[i]);
+    if(!filter || strstr("snake autopilot games", filter))
+        bench_autopilot_games();
+    return 0;
+}
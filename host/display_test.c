@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <string.h>
+#include "globals.h"
+#include "display.h"
+#include "sim.h"
+#include "test.h"
+
+//checks that a flush only sends the tiles that changed, display_stats is compared with what the
+//simulated panel received on the bus, run by ctest or as game_console_display_test
+u8g2_t u8g2;
+u8g2_esp32_hal_t u8g2_esp32_hal = U8G2_ESP32_HAL_DEFAULT;
+
+//the panel shows exactly the frame that was flushed last
+static bool test_panel_matches()
+{
+    uint8_t panel[SIM_PANEL_WIDTH * SIM_PANEL_PAGES];
+    sim_panel_copy(panel);
+    return !memcmp(panel, u8g2_GetBufferPtr(&u8g2), DISPLAY_BUFFER_SIZE);
+}
+
+static void test_full_frame()
+{
+    //the first flush has no shadow to compare against and sends every tile
+    u8g2_ClearBuffer(&u8g2);
+    u8g2_DrawBox(&u8g2, 10, 10, 40, 20);
+    u8g2_DrawFrame(&u8g2, 60, 36, 30, 12);
+    display_invalidate();
+    display_reset_stats();
+    uint32_t data_bytes = sim_stats.data_bytes;
+    display_flush();
+    TEST_CHECK(display_stats.frames == 1);
+    TEST_CHECK(display_stats.tiles_sent == DISPLAY_TILES * DISPLAY_PAGES);
+    TEST_CHECK(display_stats.bytes_sent == DISPLAY_BUFFER_SIZE);
+    TEST_CHECK(sim_stats.data_bytes - data_bytes == DISPLAY_BUFFER_SIZE);
+    TEST_CHECK(test_panel_matches());
+
+    //flushing the same frame again sends nothing at all
+    display_reset_stats();
+    uint32_t transfers = sim_stats.transfers;
+    display_flush();
+    TEST_CHECK(display_stats.transfers == 0);
+    TEST_CHECK(display_stats.tiles_sent == 0);
+    TEST_CHECK(sim_stats.transfers == transfers);
+}
+
+static void test_one_tile()
+{
+    //one changed byte dirties its 8 byte tile and only that tile goes out
+    uint8_t* buffer = u8g2_GetBufferPtr(&u8g2);
+    buffer[3 * DISPLAY_WIDTH + 5 * 8 + 2] ^= 0xff;
+    display_reset_stats();
+    uint32_t data_bytes = sim_stats.data_bytes;
+    display_flush();
+    TEST_CHECK(display_stats.transfers == 1);
+    TEST_CHECK(display_stats.tiles_sent == 1);
+    TEST_CHECK(display_stats.bytes_sent == 8);
+    TEST_CHECK(sim_stats.data_bytes - data_bytes == 8);
+    TEST_CHECK(test_panel_matches());
+
+    //two neighbouring tiles go out as one run, a tile further along the page as a second one
+    buffer[6 * DISPLAY_WIDTH + 0 * 8] ^= 0x01;
+    buffer[6 * DISPLAY_WIDTH + 1 * 8 + 7] ^= 0x80;
+    buffer[6 * DISPLAY_WIDTH + 9 * 8 + 4] ^= 0x10;
+    display_reset_stats();
+    data_bytes = sim_stats.data_bytes;
+    display_flush();
+    TEST_CHECK(display_stats.transfers == 2);
+    TEST_CHECK(display_stats.tiles_sent == 3);
+    TEST_CHECK(display_stats.bytes_sent == 24);
+    TEST_CHECK(sim_stats.data_bytes - data_bytes == 24);
+    TEST_CHECK(test_panel_matches());
+}
+
+int main()
+{
+    sim_init();
+    sim_set_i2c_khz(0);
+    init_display();
+    display_init();
+    test_full_frame();
+    test_one_tile();
+    return test_report("display");
+}
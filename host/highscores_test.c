@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include "highscores.h"
+#include "sim.h"
+#include "test.h"
+
+//checks that highscores only reach nvs when a record is beaten and that a damaged record is
+//ignored at boot, the simulated nvs counts every write and commit, run by ctest or as
+//game_console_highscores_test
+#define TEST_GAMES 3
+
+static int test_scores[TEST_GAMES];
+
+//what a power cycle leaves behind, the scores start at 0 and are loaded from nvs again
+static void test_boot()
+{
+    highscores_ready = false;
+    int* slots[TEST_GAMES];
+    for(int i = 0; i < TEST_GAMES; i++)
+    {
+        test_scores[i] = 0;
+        slots[i] = &test_scores[i];
+    }
+    highscores_init(slots, TEST_GAMES);
+}
+
+//the end screen of game i, it raises the record when the score beats it and commits
+static void test_game_over(int game, int score)
+{
+    if(score > test_scores[game])
+        test_scores[game] = score;
+    highscores_commit();
+}
+
+static void test_store(const highscores_record* record)
+{
+    nvs_handle_t handle;
+    TEST_CHECK(nvs_open(HIGHSCORES_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK);
+    TEST_CHECK(nvs_set_blob(handle, HIGHSCORES_KEY, record, sizeof(*record)) == ESP_OK);
+}
+
+static void test_coalescing()
+{
+    nvs_flash_erase();
+    test_boot();
+    uint32_t writes = sim_stats.nvs_writes, commits = sim_stats.nvs_commits;
+
+    //nothing to beat on an empty record but a zero score, and nothing is written for it
+    test_game_over(0, 0);
+    TEST_CHECK(sim_stats.nvs_writes == writes && sim_stats.nvs_commits == commits);
+
+    //every beaten record is one write and one commit
+    test_game_over(0, 120);
+    TEST_CHECK(sim_stats.nvs_writes == writes + 1 && sim_stats.nvs_commits == commits + 1);
+    test_game_over(1, 40);
+    TEST_CHECK(sim_stats.nvs_writes == writes + 2 && sim_stats.nvs_commits == commits + 2);
+
+    //games that stay below their record write nothing
+    test_game_over(0, 80);
+    test_game_over(1, 40);
+    test_game_over(2, 0);
+    TEST_CHECK(sim_stats.nvs_writes == writes + 2 && sim_stats.nvs_commits == commits + 2);
+
+    //the records survive a reboot, and loading them writes nothing
+    test_boot();
+    TEST_CHECK(test_scores[0] == 120 && test_scores[1] == 40 && test_scores[2] == 0);
+    test_game_over(0, 100);
+    TEST_CHECK(sim_stats.nvs_writes == writes + 2 && sim_stats.nvs_commits == commits + 2);
+    test_game_over(2, 7);
+    TEST_CHECK(sim_stats.nvs_writes == writes + 3 && sim_stats.nvs_commits == commits + 3);
+}
+
+static void test_damaged_records()
+{
+    highscores_record record;
+    memset(&record, 0, sizeof(record));
+    record.version = HIGHSCORES_VERSION;
+    record.count = TEST_GAMES;
+    record.scores[0] = 500, record.scores[1] = 60, record.scores[2] = 9;
+    record.crc = highscores_crc(&record);
+
+    //a good record loads
+    nvs_flash_erase();
+    test_store(&record);
+    test_boot();
+    TEST_CHECK(test_scores[0] == 500 && test_scores[1] == 60 && test_scores[2] == 9);
+
+    //a flipped bit fails the crc and the scores stay at 0
+    highscores_record damaged = record;
+    damaged.scores[1] ^= 0x100;
+    test_store(&damaged);
+    test_boot();
+    TEST_CHECK(test_scores[0] == 0 && test_scores[1] == 0 && test_scores[2] == 0);
+
+    //so does a record from another layout version, even with a matching crc
+    damaged = record;
+    damaged.version = HIGHSCORES_VERSION + 1;
+    damaged.crc = highscores_crc(&damaged);
+    test_store(&damaged);
+    test_boot();
+    TEST_CHECK(test_scores[0] == 0 && test_scores[1] == 0 && test_scores[2] == 0);
+
+    //and a blob of the wrong size
+    nvs_handle_t handle;
+    TEST_CHECK(nvs_open(HIGHSCORES_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK);
+    TEST_CHECK(nvs_set_blob(handle, HIGHSCORES_KEY, &record, sizeof(record) - 4) == ESP_OK);
+    test_boot();
+    TEST_CHECK(test_scores[0] == 0 && test_scores[1] == 0 && test_scores[2] == 0);
+
+    //the first record beaten after that replaces the damaged blob with a good one
+    test_game_over(1, 3);
+    test_boot();
+    TEST_CHECK(test_scores[0] == 0 && test_scores[1] == 3 && test_scores[2] == 0);
+}
+
+int main()
+{
+    test_coalescing();
+    test_damaged_records();
+    return test_report("highscores");
+}
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <string.h>
+#include "globals.h"
+#include "display.h"
+#include "input.h"
+#include "sim.h"
+#include "test.h"
+
+//drives the button debounce and event queue with synthetic edge streams, and the isr and settle
+//timer through the simulated gpio, run by ctest or as game_console_input_test
+u8g2_t u8g2;
+u8g2_esp32_hal_t u8g2_esp32_hal = U8G2_ESP32_HAL_DEFAULT;
+
+//what the isr does for one edge, returns whether it was accepted
+static bool test_edge(input_debouncer* filter, uint8_t button, bool level, int64_t now_us)
+{
+    input_event event;
+    if(!input_debounce_edge(filter, button, level, now_us, &event))
+        return false;
+    input_push(&event);
+    return true;
+}
+
+static void test_reset()
+{
+    memset(&input_filter, 0, sizeof(input_filter));
+    input_flush();
+    input_dropped = 0;
+}
+
+static void test_expect_event(uint8_t button, bool pressed, int64_t time_us)
+{
+    input_event event;
+    TEST_CHECK(input_poll(&event));
+    TEST_CHECK(event.button == button);
+    TEST_CHECK(event.pressed == pressed);
+    TEST_CHECK(event.time_us == time_us);
+}
+
+static void test_debounce_window()
+{
+    test_reset();
+    TEST_CHECK(test_edge(&input_filter, INPUT_LEFT, true, 1000));
+    TEST_CHECK(input_held(INPUT_LEFT));
+    //the same level again is no edge at all
+    TEST_CHECK(!test_edge(&input_filter, INPUT_LEFT, true, 20000));
+    //a release inside the window is a bounce, one right at its end is real
+    TEST_CHECK(!test_edge(&input_filter, INPUT_LEFT, false, 1000 + INPUT_DEBOUNCE_US - 1));
+    TEST_CHECK(input_held(INPUT_LEFT));
+    TEST_CHECK(test_edge(&input_filter, INPUT_LEFT, false, 1000 + INPUT_DEBOUNCE_US));
+    TEST_CHECK(!input_held(INPUT_LEFT));
+
+    test_expect_event(INPUT_LEFT, true, 1000);
+    test_expect_event(INPUT_LEFT, false, 1000 + INPUT_DEBOUNCE_US);
+    input_event event;
+    TEST_CHECK(!input_poll(&event));
+}
+
+static void test_bounce_burst()
+{
+    test_reset();
+    //contacts chatter every 300 us for 6 ms after the press, only the first edge counts
+    int64_t now_us = 50000;
+    TEST_CHECK(test_edge(&input_filter, INPUT_UP, true, now_us));
+    bool level = true;
+    for(int64_t t = now_us + 300; t < now_us + 6000; t += 300)
+    {
+        level = !level;
+        TEST_CHECK(!test_edge(&input_filter, INPUT_UP, level, t));
+    }
+    //the burst ended on the pressed level, the release comes much later
+    TEST_CHECK(!test_edge(&input_filter, INPUT_UP, true, now_us + 6300));
+    TEST_CHECK(test_edge(&input_filter, INPUT_UP, false, now_us + 100000));
+
+    test_expect_event(INPUT_UP, true, now_us);
+    test_expect_event(INPUT_UP, false, now_us + 100000);
+    input_event event;
+    TEST_CHECK(!input_poll(&event));
+}
+
+static void test_press_release_pairs()
+{
+    test_reset();
+    //buttons debounce on their own, an edge on one never hides an edge on another
+    TEST_CHECK(test_edge(&input_filter, INPUT_LEFT, true, 10000));
+    TEST_CHECK(test_edge(&input_filter, INPUT_RIGHT, true, 10100));
+    TEST_CHECK(test_edge(&input_filter, INPUT_DOWN, true, 10200));
+    TEST_CHECK(test_edge(&input_filter, INPUT_LEFT, false, 30000));
+    TEST_CHECK(test_edge(&input_filter, INPUT_RIGHT, false, 30100));
+    TEST_CHECK(test_edge(&input_filter, INPUT_DOWN, false, 30200));
+    TEST_CHECK(input_filter.state == 0);
+
+    test_expect_event(INPUT_LEFT, true, 10000);
+    test_expect_event(INPUT_RIGHT, true, 10100);
+    test_expect_event(INPUT_DOWN, true, 10200);
+    test_expect_event(INPUT_LEFT, false, 30000);
+    test_expect_event(INPUT_RIGHT, false, 30100);
+    test_expect_event(INPUT_DOWN, false, 30200);
+    input_event event;
+    TEST_CHECK(!input_poll(&event));
+}
+
+static void test_overflow()
+{
+    test_reset();
+    //a full ring drops the newest edges and keeps the oldest ones in order
+    int64_t now_us = 100000;
+    for(int i = 0; i < INPUT_QUEUE_SIZE + 4; i++)
+    {
+        now_us += INPUT_DEBOUNCE_US;
+        test_edge(&input_filter, INPUT_RIGHT, i % 2 == 0, now_us);
+    }
+    TEST_CHECK(input_dropped == 4);
+
+    now_us = 100000;
+    for(int i = 0; i < INPUT_QUEUE_SIZE; i++)
+    {
+        now_us += INPUT_DEBOUNCE_US;
+        test_expect_event(INPUT_RIGHT, i % 2 == 0, now_us);
+    }
+    input_event event;
+    TEST_CHECK(!input_poll(&event));
+
+    //the ring keeps working once it drained, also across the wrap of its indices
+    for(int i = 0; i < 3 * INPUT_QUEUE_SIZE; i++)
+    {
+        input_event pushed = {.time_us = i, .button = i % INPUT_BUTTON_COUNT, .pressed = i % 2};
+        input_push(&pushed);
+        test_expect_event(i % INPUT_BUTTON_COUNT, i % 2, i);
+    }
+    TEST_CHECK(input_dropped == 4);
+}
+
+static void test_settle_timer()
+{
+    test_reset();
+    //a tap shorter than the window, the release edge is rejected and read again when it ends
+    sim_advance_us(100000);
+    int64_t press_us = sim_now_us();
+    sim_set_level(RIGHT_BUTTON, true);
+    sim_advance_us(3000);
+    sim_set_level(RIGHT_BUTTON, false);
+    TEST_CHECK(input_held(INPUT_RIGHT));
+    test_expect_event(INPUT_RIGHT, true, press_us);
+    input_event event;
+    TEST_CHECK(!input_poll(&event));
+
+    sim_advance_us(INPUT_DEBOUNCE_US);
+    TEST_CHECK(!input_held(INPUT_RIGHT));
+    test_expect_event(INPUT_RIGHT, false, press_us + INPUT_DEBOUNCE_US);
+    TEST_CHECK(!input_poll(&event));
+
+    //a bounce that settles back on the debounced level inside the window adds no edge
+    sim_advance_us(50000);
+    press_us = sim_now_us();
+    sim_set_level(UP_BUTTON, true);
+    sim_advance_us(1000);
+    sim_set_level(UP_BUTTON, false);
+    sim_advance_us(1000);
+    sim_set_level(UP_BUTTON, true);
+    sim_advance_us(2 * INPUT_DEBOUNCE_US);
+    TEST_CHECK(input_held(INPUT_UP));
+    test_expect_event(INPUT_UP, true, press_us);
+    TEST_CHECK(!input_poll(&event));
+    sim_set_level(UP_BUTTON, false);
+    test_expect_event(INPUT_UP, false, sim_now_us());
+}
+
+int main()
+{
+    test_debounce_window();
+    test_bounce_burst();
+    test_press_release_pairs();
+    test_overflow();
+    sim_init();
+    input_init();
+    test_settle_timer();
+    return test_report("input");
+}
@@ -0,0 +1,991 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <driver/gpio.h>
+#include <esp_cpu.h>
+#include <esp_crc.h>
+#include <esp_rom_sys.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include "u8g2_esp32_hal.h"
+#include "sim.h"
+
+#define SIM_PINS            40
+#define SIM_SCRIPT_SIZE     4096
+#define SIM_TAP_MS          60
+#define SIM_TICK_US         (1000000 / configTICK_RATE_HZ)
+#define SIM_GDDRAM_COLUMNS  132
+#define SIM_COLUMN_OFFSET   2     //the 128 px sh1106 panels show columns 2..129
+#define SIM_NVS_ENTRIES     16
+#define SIM_NVS_NAMESPACES  4
+#define SIM_NVS_NAME_SIZE   16
+#define SIM_I2C_BYTE_BITS   9     //eight data bits and the ack
+#define SIM_I2C_FRAME_BITS  2     //start and stop condition
+#define SIM_TASKS           4
+#define SIM_TIMERS          8
+
+typedef struct sim_event
+{
+    int64_t time_us;
+    int order;
+    uint8_t pin;
+    bool level;
+} sim_event;
+
+//same pins as main/globals.h
+static const struct { const char* name; uint8_t pin; } sim_buttons[] =
+{
+    {"left", 15}, {"down", 2}, {"right", 26}, {"up", 27},
+};
+
+sim_counters sim_stats;
+
+//tasks besides the game thread, virtual time only moves once each of them waits on a queue
+//that has nothing for it, so a frame handed to the flush task is on the panel before it is shown
+typedef struct sim_task
+{
+    TaskFunction_t function;
+    void* parameters;
+    QueueHandle_t blocked_on;   //set while the task waits on a queue
+    bool receiving;
+    bool finished;
+} sim_task;
+
+static sim_task sim_tasks[SIM_TASKS];
+static int sim_task_count = 0;
+static __thread sim_task* sim_current_task = NULL;
+static void sim_wait_for_tasks();
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void* arg;
+    bool armed;
+    int64_t alarm_us;
+};
+
+static struct esp_timer sim_timers[SIM_TIMERS];
+static int sim_timer_count = 0;
+
+static sim_event sim_script[SIM_SCRIPT_SIZE];
+static int sim_script_length = 0;
+static int sim_script_next = 0;
+static int64_t sim_script_end_us = 0;
+static int64_t sim_tail_us = 5000000;
+static int64_t sim_max_us = INT64_MAX;
+static unsigned int sim_seed = 1;
+static int64_t sim_time_us = 0;
+static struct timespec sim_wall_start;
+static pthread_t sim_main_thread;
+static int sim_i2c_khz = 400;
+
+static bool sim_levels[SIM_PINS];
+static gpio_int_type_t sim_intr_types[SIM_PINS];
+static gpio_isr_t sim_isr_handlers[SIM_PINS];
+static void* sim_isr_args[SIM_PINS];
+
+static uint64_t sim_ext1_mask = 0;
+static uint64_t sim_ext1_status = 0;
+static uint64_t sim_timer_wakeup_us = 0;
+static esp_sleep_wakeup_cause_t sim_wakeup_cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+
+//sh1106 state, the flush task may write it while the game thread captures frames
+static pthread_mutex_t sim_panel_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t sim_gddram[SIM_PANEL_PAGES][SIM_GDDRAM_COLUMNS];
+static uint8_t sim_page = 0;
+static uint8_t sim_column = 0;
+static uint8_t sim_control = 0;
+static bool sim_expect_control = false;
+static uint8_t sim_pending_arguments = 0;
+static bool sim_panel_changed = false;
+static uint32_t sim_transfer_bytes = 0;
+
+static const char* sim_frame_dir = NULL;
+static int sim_frame_every = 1;
+static uint32_t sim_frame_index = 0;
+
+static void sim_wall_time(struct timespec* now)
+{
+    clock_gettime(CLOCK_MONOTONIC, now);
+}
+
+static int sim_compare_events(const void* a, const void* b)
+{
+    const sim_event* left = a;
+    const sim_event* right = b;
+    if(left->time_us != right->time_us)
+        return left->time_us < right->time_us ? -1 : 1;
+    return left->order - right->order;
+}
+
+static int sim_button_pin(const char* name)
+{
+    for(size_t i = 0; i < sizeof(sim_buttons) / sizeof(sim_buttons[0]); i++)
+        if(!strcasecmp(name, sim_buttons[i].name))
+            return sim_buttons[i].pin;
+    if(!strncasecmp(name, "gpio", 4))
+    {
+        int pin = atoi(name + 4);
+        if(pin >= 0 && pin < SIM_PINS)
+            return pin;
+    }
+    return -1;
+}
+
+static bool sim_add_event(int64_t time_us, int pin, bool level)
+{
+    if(sim_script_length == SIM_SCRIPT_SIZE)
+        return false;
+    sim_script[sim_script_length] = (sim_event){time_us, sim_script_length, pin, level};
+    sim_script_length++;
+    return true;
+}
+
+void sim_init(void)
+{
+    sim_wall_time(&sim_wall_start);
+    sim_main_thread = pthread_self();
+}
+
+bool sim_load_script(const char* path)
+{
+    FILE* file = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if(!file)
+    {
+        perror(path);
+        return false;
+    }
+
+    char line[128];
+    int line_number = 0;
+    int64_t time_us = 0;
+    bool ok = true;
+    while(ok && fgets(line, sizeof(line), file))
+    {
+        line_number++;
+        char* comment = strchr(line, '#');
+        if(comment)
+            *comment = '\0';
+
+        long delay_ms;
+        char button[16], action[16] = "tap";
+        int fields = sscanf(line, "%ld %15s %15s", &delay_ms, button, action);
+        if(fields <= 0)
+            continue;
+
+        int pin = fields >= 2 ? sim_button_pin(button) : -1;
+        if(fields < 2 || delay_ms < 0 || pin < 0)
+        {
+            fprintf(stderr, "%s:%d: expected \"<delay_ms> <button> [tap|press|release]\"\n", path, line_number);
+            ok = false;
+            break;
+        }
+
+        time_us += delay_ms * 1000;
+        if(!strcasecmp(action, "press"))
+            ok = sim_add_event(time_us, pin, true);
+        else if(!strcasecmp(action, "release"))
+            ok = sim_add_event(time_us, pin, false);
+        else if(!strcasecmp(action, "tap"))
+            ok = sim_add_event(time_us, pin, true) && sim_add_event(time_us + SIM_TAP_MS * 1000, pin, false);
+        else
+        {
+            fprintf(stderr, "%s:%d: unknown action \"%s\"\n", path, line_number, action);
+            ok = false;
+        }
+        if(!ok && sim_script_length == SIM_SCRIPT_SIZE)
+            fprintf(stderr, "%s:%d: script longer than %d events\n", path, line_number, SIM_SCRIPT_SIZE);
+    }
+    if(file != stdin)
+        fclose(file);
+
+    qsort(sim_script, sim_script_length, sizeof(sim_script[0]), sim_compare_events);
+    sim_script_end_us = sim_script_length ? sim_script[sim_script_length - 1].time_us : 0;
+    return ok;
+}
+
+void sim_set_frame_output(const char* dir, int every)
+{
+    sim_frame_dir = dir;
+    sim_frame_every = every > 0 ? every : 1;
+}
+
+void sim_set_tail_ms(int tail_ms)
+{
+    sim_tail_us = (int64_t)tail_ms * 1000;
+}
+
+void sim_set_max_ms(int max_ms)
+{
+    sim_max_us = (int64_t)max_ms * 1000;
+}
+
+void sim_set_seed(unsigned int seed)
+{
+    sim_seed = seed;
+}
+
+void sim_set_i2c_khz(int khz)
+{
+    sim_i2c_khz = khz > 0 ? khz : 0;
+}
+
+//game_console.c is linked with --wrap=time so srand(time(0)) replays the same games
+time_t __wrap_time(time_t* out)
+{
+    time_t value = sim_seed;
+    if(out)
+        *out = value;
+    return value;
+}
+
+//---------------------------------- panel ---------------------------------------------------------
+static void sim_bus_transfer(int64_t us);
+
+static void sim_panel_command(uint8_t command)
+{
+    if(sim_pending_arguments)
+    {
+        sim_pending_arguments--;
+        return;
+    }
+    if(command <= 0x0f)
+        sim_column = (sim_column & 0xf0) | command;
+    else if(command <= 0x1f)
+        sim_column = (sim_column & 0x0f) | ((command & 0x0f) << 4);
+    else if(command >= 0xb0 && command <= 0xb7)
+        sim_page = command & 0x07;
+    else
+    {
+        switch(command)
+        {
+            //two byte commands, the argument must not be read as a column or page address
+            case 0x81: case 0x8d: case 0xa8: case 0xad: case 0xd3:
+            case 0xd5: case 0xd9: case 0xda: case 0xdb:
+                sim_pending_arguments = 1;
+                break;
+        }
+    }
+}
+
+static void sim_panel_data(uint8_t data)
+{
+    if(sim_column < SIM_GDDRAM_COLUMNS && sim_gddram[sim_page][sim_column] != data)
+    {
+        sim_gddram[sim_page][sim_column] = data;
+        sim_panel_changed = true;
+    }
+    sim_column++;
+}
+
+//every i2c transaction starts with a control byte, 0x00 commands follow, 0x40 data follows,
+//with the continuation bit (0x80) set only one byte follows before the next control byte
+static void sim_panel_byte(uint8_t byte)
+{
+    sim_stats.bytes_sent++;
+    sim_transfer_bytes++;
+    if(sim_expect_control)
+    {
+        sim_control = byte;
+        sim_expect_control = false;
+        return;
+    }
+
+    if(sim_control & 0x40)
+    {
+        sim_stats.data_bytes++;
+        sim_panel_data(byte);
+    }
+    else
+        sim_panel_command(byte);
+
+    if(sim_control & 0x80)
+        sim_expect_control = true;
+}
+
+void u8g2_esp32_hal_init(u8g2_esp32_hal_t u8g2_esp32_hal_param)
+{
+}
+
+uint8_t u8g2_esp32_i2c_byte_cb(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr)
+{
+    switch(msg)
+    {
+        case U8X8_MSG_BYTE_START_TRANSFER:
+            pthread_mutex_lock(&sim_panel_lock);
+            sim_stats.transfers++;
+            sim_stats.bytes_sent++; //address byte
+            sim_transfer_bytes = 1;
+            sim_expect_control = true;
+            break;
+        case U8X8_MSG_BYTE_SEND:
+            for(int i = 0; i < arg_int; i++)
+                sim_panel_byte(((const uint8_t*)arg_ptr)[i]);
+            break;
+        case U8X8_MSG_BYTE_END_TRANSFER:
+        {
+            uint32_t bits = sim_transfer_bytes * SIM_I2C_BYTE_BITS + SIM_I2C_FRAME_BITS;
+            pthread_mutex_unlock(&sim_panel_lock);
+            if(sim_i2c_khz)
+                sim_bus_transfer((int64_t)bits * 1000 / sim_i2c_khz);
+            break;
+        }
+    }
+    return 1;
+}
+
+uint8_t u8g2_esp32_gpio_and_delay_cb(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr)
+{
+    return 1;
+}
+
+void sim_panel_copy(uint8_t* buffer)
+{
+    pthread_mutex_lock(&sim_panel_lock);
+    for(int page = 0; page < SIM_PANEL_PAGES; page++)
+        memcpy(buffer + page * SIM_PANEL_WIDTH, sim_gddram[page] + SIM_COLUMN_OFFSET, SIM_PANEL_WIDTH);
+    pthread_mutex_unlock(&sim_panel_lock);
+}
+
+//binary pbm, lit pixels are black
+bool sim_write_pbm(const char* path, const uint8_t* buffer)
+{
+    FILE* file = fopen(path, "wb");
+    if(!file)
+    {
+        perror(path);
+        return false;
+    }
+    fprintf(file, "P4\n%d %d\n", SIM_PANEL_WIDTH, SIM_PANEL_HEIGHT);
+    for(int y = 0; y < SIM_PANEL_HEIGHT; y++)
+    {
+        uint8_t row[SIM_PANEL_WIDTH / 8] = {0};
+        for(int x = 0; x < SIM_PANEL_WIDTH; x++)
+            if(buffer[(y / 8) * SIM_PANEL_WIDTH + x] & (1 << (y % 8)))
+                row[x / 8] |= 0x80 >> (x % 8);
+        fwrite(row, 1, sizeof(row), file);
+    }
+    fclose(file);
+    return true;
+}
+
+//called whenever virtual time is about to move, the panel contents at that point are a shown frame
+static void sim_capture_frame()
+{
+    sim_wait_for_tasks();
+    pthread_mutex_lock(&sim_panel_lock);
+    bool changed = sim_panel_changed;
+    sim_panel_changed = false;
+    pthread_mutex_unlock(&sim_panel_lock);
+    if(!changed)
+        return;
+
+    sim_stats.panel_frames++;
+    if(!sim_frame_dir || sim_frame_index++ % sim_frame_every)
+        return;
+
+    uint8_t buffer[SIM_PANEL_WIDTH * SIM_PANEL_PAGES];
+    char path[512];
+    sim_panel_copy(buffer);
+    snprintf(path, sizeof(path), "%s/frame_%05u_%08lld.pbm", sim_frame_dir,
+        (unsigned)sim_stats.frames_written, (long long)(sim_time_us / 1000));
+    if(sim_write_pbm(path, buffer))
+        sim_stats.frames_written++;
+}
+
+//----------------------------------- time ---------------------------------------------------------
+void sim_print_stats(const char* reason)
+{
+    struct timespec now;
+    sim_wall_time(&now);
+    double wall_s = (now.tv_sec - sim_wall_start.tv_sec) + (now.tv_nsec - sim_wall_start.tv_nsec) / 1e9;
+    sim_stats.virtual_us = sim_time_us;
+
+    fprintf(stderr, "sim: %s\n", reason);
+    fprintf(stderr, "sim: %u nvs writes, %u nvs commits\n",
+        (unsigned)sim_stats.nvs_writes, (unsigned)sim_stats.nvs_commits);
+    fprintf(stderr, "sim: %.3f s virtual in %.3f s wall, %u panel frames (%u written), %u sleeps\n",
+        sim_time_us / 1e6, wall_s, (unsigned)sim_stats.panel_frames,
+        (unsigned)sim_stats.frames_written, (unsigned)sim_stats.sleeps);
+    fprintf(stderr, "sim: %u i2c transfers, %u bytes on the bus, %u of them pixel data\n",
+        (unsigned)sim_stats.transfers, (unsigned)sim_stats.bytes_sent, (unsigned)sim_stats.data_bytes);
+    int64_t awake_us = sim_time_us - sim_stats.asleep_us;
+    if(sim_i2c_khz)
+        fprintf(stderr, "sim: bus busy %.1f ms at %d kHz\n", sim_stats.bus_us / 1e3, sim_i2c_khz);
+    if(awake_us > 0)
+        fprintf(stderr, "sim: %.1f panel frames per second while awake\n", sim_stats.panel_frames * 1e6 / awake_us);
+}
+
+void sim_finish(const char* reason)
+{
+    sim_capture_frame();
+    sim_print_stats(reason);
+    fflush(stdout);
+    exit(0);
+}
+
+static void sim_apply_event(const sim_event* event, bool interrupts)
+{
+    bool previous = sim_levels[event->pin];
+    sim_levels[event->pin] = event->level;
+    if(!interrupts || previous == event->level || !sim_isr_handlers[event->pin])
+        return;
+
+    gpio_int_type_t type = sim_intr_types[event->pin];
+    if(type == GPIO_INTR_ANYEDGE || (type == GPIO_INTR_POSEDGE && event->level) ||
+        (type == GPIO_INTR_NEGEDGE && !event->level))
+        sim_isr_handlers[event->pin](sim_isr_args[event->pin]);
+}
+
+static void sim_check_end()
+{
+    if(sim_time_us >= sim_max_us)
+        sim_finish("time limit reached");
+    if(sim_script_next == sim_script_length && sim_time_us >= sim_script_end_us + sim_tail_us)
+        sim_finish("script finished");
+}
+
+//the armed timer that fires first, NULL if none is
+static esp_timer_handle_t sim_next_timer()
+{
+    esp_timer_handle_t next = NULL;
+    for(int i = 0; i < sim_timer_count; i++)
+        if(sim_timers[i].armed && (!next || sim_timers[i].alarm_us < next->alarm_us))
+            next = &sim_timers[i];
+    return next;
+}
+
+//script edges and timers up to target_us in the order they happen
+static void sim_play_events(int64_t target_us)
+{
+    while(true)
+    {
+        const sim_event* event = sim_script_next < sim_script_length &&
+            sim_script[sim_script_next].time_us <= target_us ? &sim_script[sim_script_next] : NULL;
+        esp_timer_handle_t timer = sim_next_timer();
+        if(timer && timer->alarm_us <= target_us && (!event || timer->alarm_us < event->time_us))
+        {
+            if(timer->alarm_us > sim_time_us)
+                sim_time_us = timer->alarm_us;
+            timer->armed = false;
+            timer->callback(timer->arg);
+        }
+        else if(event)
+        {
+            sim_script_next++;
+            if(event->time_us > sim_time_us)
+                sim_time_us = event->time_us;
+            sim_apply_event(event, true);
+        }
+        else
+            break;
+    }
+}
+
+static void sim_advance_to(int64_t target_us)
+{
+    sim_capture_frame();
+    sim_play_events(target_us);
+    if(target_us > sim_time_us)
+        sim_time_us = target_us;
+    sim_check_end();
+}
+
+//the game thread is stalled for as long as a blocking flush keeps the bus busy, buttons keep
+//firing meanwhile, the panel is mid update so no frame is captured, transfers from the async
+//flush task only count as busy time since they run beside the game
+static void sim_bus_transfer(int64_t us)
+{
+    sim_stats.bus_us += us;
+    if(!pthread_equal(pthread_self(), sim_main_thread))
+        return;
+    int64_t target_us = sim_time_us + us;
+    sim_play_events(target_us);
+    sim_time_us = target_us;
+}
+
+void sim_set_level(uint8_t pin, bool level)
+{
+    sim_event event = {sim_time_us, 0, pin, level};
+    sim_apply_event(&event, true);
+}
+
+int64_t sim_now_us(void)
+{
+    return sim_time_us;
+}
+
+void sim_advance_us(int64_t us)
+{
+    sim_advance_to(sim_time_us + us);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return sim_time_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle)
+{
+    if(!create_args || !create_args->callback || !out_handle)
+        return ESP_ERR_INVALID_ARG;
+    if(sim_timer_count == SIM_TIMERS)
+        return ESP_ERR_NO_MEM;
+    esp_timer_handle_t timer = &sim_timers[sim_timer_count++];
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    timer->armed = false;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if(timer->armed)
+        return ESP_ERR_INVALID_STATE;
+    timer->armed = true;
+    timer->alarm_us = sim_time_us + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if(!timer->armed)
+        return ESP_ERR_INVALID_STATE;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    sim_advance_to(sim_time_us + us);
+}
+
+uint32_t esp_cpu_get_cycle_count(void)
+{
+    struct timespec now;
+    sim_wall_time(&now);
+    uint64_t ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    return (uint32_t)(ns * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ / 1000);
+}
+
+//------------------------------------ gpio and sleep ----------------------------------------------
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_pullup_dis(gpio_num_t gpio_num)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_pulldown_en(gpio_num_t gpio_num)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if(gpio_num < 0 || gpio_num >= SIM_PINS)
+        return ESP_ERR_INVALID_ARG;
+    sim_intr_types[gpio_num] = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void* args)
+{
+    if(gpio_num < 0 || gpio_num >= SIM_PINS)
+        return ESP_ERR_INVALID_ARG;
+    sim_isr_handlers[gpio_num] = isr_handler;
+    sim_isr_args[gpio_num] = args;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < SIM_PINS && sim_levels[gpio_num];
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode)
+{
+    if(mode != ESP_EXT1_WAKEUP_ANY_HIGH)
+        return ESP_ERR_INVALID_ARG;
+    sim_ext1_mask = mask;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+    sim_timer_wakeup_us = time_in_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t source)
+{
+    if(source == ESP_SLEEP_WAKEUP_TIMER || source == ESP_SLEEP_WAKEUP_ALL)
+        sim_timer_wakeup_us = 0;
+    if(source == ESP_SLEEP_WAKEUP_EXT1 || source == ESP_SLEEP_WAKEUP_ALL)
+        sim_ext1_mask = 0;
+    return ESP_OK;
+}
+
+static uint64_t sim_ext1_high_pins()
+{
+    uint64_t pins = 0;
+    for(int pin = 0; pin < SIM_PINS; pin++)
+        if((sim_ext1_mask & (1ULL << pin)) && sim_levels[pin])
+            pins |= 1ULL << pin;
+    return pins;
+}
+
+//jumps straight to the next wakeup, edges while asleep change levels but fire no interrupts
+esp_err_t esp_light_sleep_start(void)
+{
+    sim_capture_frame();
+    sim_stats.sleeps++;
+    int64_t sleep_start_us = sim_time_us;
+
+    int64_t timer_wake_us = sim_timer_wakeup_us ? sim_time_us + (int64_t)sim_timer_wakeup_us : INT64_MAX;
+    while(!sim_ext1_high_pins() && sim_script_next < sim_script_length &&
+        sim_script[sim_script_next].time_us < timer_wake_us)
+    {
+        const sim_event* event = &sim_script[sim_script_next++];
+        if(event->time_us > sim_time_us)
+            sim_time_us = event->time_us;
+        sim_apply_event(event, false);
+    }
+
+    sim_ext1_status = sim_ext1_high_pins();
+    if(sim_ext1_status)
+        sim_wakeup_cause = ESP_SLEEP_WAKEUP_EXT1;
+    else if(timer_wake_us != INT64_MAX)
+    {
+        sim_time_us = timer_wake_us;
+        sim_wakeup_cause = ESP_SLEEP_WAKEUP_TIMER;
+    }
+    else
+        sim_finish("script finished while sleeping");
+    sim_stats.asleep_us += sim_time_us - sleep_start_us;
+    sim_check_end();
+    return ESP_OK;
+}
+
+uint64_t esp_sleep_get_ext1_wakeup_status(void)
+{
+    return sim_ext1_status;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void)
+{
+    return sim_wakeup_cause;
+}
+
+//------------------------------------ freertos ----------------------------------------------------
+TickType_t xTaskGetTickCount(void)
+{
+    return sim_time_us / SIM_TICK_US;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if(ticks == 0)
+    {
+        sched_yield();
+        return;
+    }
+    sim_advance_to((int64_t)(xTaskGetTickCount() + ticks) * SIM_TICK_US);
+}
+
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake_time, TickType_t time_increment)
+{
+    TickType_t wake = *previous_wake_time + time_increment;
+    *previous_wake_time = wake;
+    if((int32_t)(wake - xTaskGetTickCount()) <= 0)
+        return pdFALSE;
+    sim_advance_to((int64_t)wake * SIM_TICK_US);
+    return pdTRUE;
+}
+
+static void* sim_task_entry(void* arg)
+{
+    sim_task* task = arg;
+    sim_current_task = task;
+    task->function(task->parameters);
+    __atomic_store_n(&task->finished, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack_depth,
+    void* parameters, UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id)
+{
+    if(sim_task_count == SIM_TASKS)
+        return pdFAIL;
+    sim_task* start = &sim_tasks[sim_task_count];
+    start->function = task;
+    start->parameters = parameters;
+
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, sim_task_entry, start))
+        return pdFAIL;
+    sim_task_count++;
+    pthread_detach(thread);
+    if(created_task)
+        *created_task = (TaskHandle_t)thread;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if(task)
+        return;
+    if(sim_current_task)
+        __atomic_store_n(&sim_current_task->finished, true, __ATOMIC_RELEASE);
+    pthread_exit(NULL);
+}
+
+struct QueueDefinition
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t items[];
+};
+
+//called with the queue locked
+static void sim_task_wait(QueueHandle_t queue, bool receiving)
+{
+    if(sim_current_task)
+    {
+        sim_current_task->receiving = receiving;
+        __atomic_store_n(&sim_current_task->blocked_on, queue, __ATOMIC_RELEASE);
+    }
+    pthread_cond_wait(&queue->changed, &queue->lock);
+    if(sim_current_task)
+        __atomic_store_n(&sim_current_task->blocked_on, NULL, __ATOMIC_RELEASE);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t queue = calloc(1, sizeof(*queue) + (size_t)length * item_size);
+    if(!queue)
+        return NULL;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&queue->lock);
+    while(queue->count == queue->length)
+    {
+        if(ticks_to_wait == 0)
+        {
+            pthread_mutex_unlock(&queue->lock);
+            return errQUEUE_FULL;
+        }
+        sim_task_wait(queue, false);
+    }
+    UBaseType_t slot = (queue->head + queue->count) % queue->length;
+    memcpy(queue->items + slot * queue->item_size, item, queue->item_size);
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&queue->lock);
+    while(queue->count == 0)
+    {
+        if(ticks_to_wait == 0)
+        {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+        sim_task_wait(queue, true);
+    }
+    memcpy(buffer, queue->items + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+//a task is idle while it waits on a queue that still has nothing for it, or once it ended
+static bool sim_task_idle(sim_task* task)
+{
+    if(__atomic_load_n(&task->finished, __ATOMIC_ACQUIRE))
+        return true;
+    QueueHandle_t queue = __atomic_load_n(&task->blocked_on, __ATOMIC_ACQUIRE);
+    if(!queue)
+        return false;
+    pthread_mutex_lock(&queue->lock);
+    bool idle = task->blocked_on == queue &&
+        (task->receiving ? queue->count == 0 : queue->count == queue->length);
+    pthread_mutex_unlock(&queue->lock);
+    return idle;
+}
+
+static void sim_wait_for_tasks()
+{
+    for(int i = 0; i < sim_task_count; i++)
+        while(&sim_tasks[i] != sim_current_task && !sim_task_idle(&sim_tasks[i]))
+            sched_yield();
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+//--------------------------------------- nvs ------------------------------------------------------
+typedef struct sim_nvs_entry
+{
+    nvs_handle_t handle;
+    char key[SIM_NVS_NAME_SIZE];
+    size_t length;
+    uint8_t* value;
+} sim_nvs_entry;
+
+static char sim_nvs_namespaces[SIM_NVS_NAMESPACES][SIM_NVS_NAME_SIZE];
+static sim_nvs_entry sim_nvs_entries[SIM_NVS_ENTRIES];
+
+static sim_nvs_entry* sim_nvs_find(nvs_handle_t handle, const char* key, bool create)
+{
+    sim_nvs_entry* free_entry = NULL;
+    for(int i = 0; i < SIM_NVS_ENTRIES; i++)
+    {
+        sim_nvs_entry* entry = &sim_nvs_entries[i];
+        if(entry->handle == handle && !strncmp(entry->key, key, SIM_NVS_NAME_SIZE))
+            return entry;
+        if(!entry->handle && !free_entry)
+            free_entry = entry;
+    }
+    if(!create || !free_entry)
+        return NULL;
+    free_entry->handle = handle;
+    strncpy(free_entry->key, key, SIM_NVS_NAME_SIZE - 1);
+    return free_entry;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    for(int i = 0; i < SIM_NVS_ENTRIES; i++)
+        free(sim_nvs_entries[i].value);
+    memset(sim_nvs_entries, 0, sizeof(sim_nvs_entries));
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle)
+{
+    for(int i = 0; i < SIM_NVS_NAMESPACES; i++)
+    {
+        if(!sim_nvs_namespaces[i][0])
+            strncpy(sim_nvs_namespaces[i], name, SIM_NVS_NAME_SIZE - 1);
+        if(!strncmp(sim_nvs_namespaces[i], name, SIM_NVS_NAME_SIZE))
+        {
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length)
+{
+    sim_nvs_entry* entry = sim_nvs_find(handle, key, false);
+    if(!entry)
+        return ESP_ERR_NVS_NOT_FOUND;
+    if(out_value)
+    {
+        if(*length < entry->length)
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        memcpy(out_value, entry->value, entry->length);
+    }
+    *length = entry->length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length)
+{
+    sim_nvs_entry* entry = sim_nvs_find(handle, key, true);
+    if(!entry)
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    uint8_t* copy = malloc(length ? length : 1);
+    if(!copy)
+        return ESP_ERR_NO_MEM;
+    memcpy(copy, value, length);
+    free(entry->value);
+    entry->value = copy;
+    entry->length = length;
+    sim_stats.nvs_writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key)
+{
+    sim_nvs_entry* entry = sim_nvs_find(handle, key, false);
+    if(!entry)
+        return ESP_ERR_NVS_NOT_FOUND;
+    free(entry->value);
+    memset(entry, 0, sizeof(*entry));
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    sim_stats.nvs_commits++;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len)
+{
+    crc = ~crc;
+    while(len--)
+    {
+        crc ^= *buf++;
+        for(int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
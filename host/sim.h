@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+//host side of the hardware stubs: a virtual clock, scripted buttons and a simulated sh1106
+
+#define SIM_PANEL_WIDTH   128
+#define SIM_PANEL_HEIGHT  64
+#define SIM_PANEL_PAGES   (SIM_PANEL_HEIGHT / 8)
+
+typedef struct sim_counters
+{
+    int64_t virtual_us;
+    uint32_t nvs_writes;       //nvs_set_blob calls that stored a value
+    uint32_t nvs_commits;
+    uint32_t panel_frames;     //times the panel contents changed between two delays
+    uint32_t frames_written;
+    uint32_t transfers;        //i2c transactions
+    uint32_t bytes_sent;       //every byte on the bus including address and control bytes
+    uint32_t data_bytes;       //gddram bytes (sent with D/C high)
+    uint32_t sleeps;
+    int64_t asleep_us;         //virtual time spent in light sleep
+    int64_t bus_us;            //time the i2c bus was busy according to the timing model
+} sim_counters;
+
+extern sim_counters sim_stats;
+
+void sim_init(void);
+
+//reads "<delay_ms> <button> [tap|press|release]" lines, delays are relative to the previous line
+bool sim_load_script(const char* path);
+void sim_set_frame_output(const char* dir, int every);
+void sim_set_tail_ms(int tail_ms);
+void sim_set_max_ms(int max_ms);
+void sim_set_seed(unsigned int seed);
+//i2c clock of the bus timing model, 0 makes transfers take no time
+void sim_set_i2c_khz(int khz);
+
+//drives a pin like a script edge at the current virtual time, its isr runs right away
+void sim_set_level(uint8_t pin, bool level);
+
+int64_t sim_now_us(void);
+void sim_advance_us(int64_t us);
+
+//what the panel shows, page major like the u8g2 buffer
+void sim_panel_copy(uint8_t* buffer);
+bool sim_write_pbm(const char* path, const uint8_t* buffer);
+
+void sim_print_stats(const char* reason);
+void sim_finish(const char* reason) __attribute__((noreturn));
@@ -0,0 +1,20 @@
+# runs a script on the async flush simulator and on the reference one without bus timing, both have
+# to show the same panel frames and send the same i2c traffic, run by ctest as sim_async
+foreach(sim ASYNC_SIM REFERENCE_SIM)
+    execute_process(COMMAND ${${sim}} --script ${SCRIPT} --i2c-khz 0
+        RESULT_VARIABLE result ERROR_VARIABLE output OUTPUT_QUIET)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${${sim}} failed: ${output}")
+    endif()
+    string(REGEX MATCH "[0-9]+ panel frames" frames "${output}")
+    string(REGEX MATCH "[0-9]+ i2c transfers, [0-9]+ bytes on the bus, [0-9]+ of them pixel data" bus "${output}")
+    if(NOT frames OR NOT bus OR frames MATCHES "^0 ")
+        message(FATAL_ERROR "${${sim}} showed no frames: ${output}")
+    endif()
+    set(${sim}_counts "${frames}, ${bus}")
+    message(STATUS "${${sim}}: ${${sim}_counts}")
+endforeach()
+
+if(NOT ASYNC_SIM_counts STREQUAL REFERENCE_SIM_counts)
+    message(FATAL_ERROR "async flush: ${ASYNC_SIM_counts}\nreference: ${REFERENCE_SIM_counts}")
+endif()
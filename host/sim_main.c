@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+
+void app_main(void);
+
+static void sim_usage(const char* program)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --script <file|->   button script, \"<delay_ms> <left|down|right|up> [tap|press|release]\" per line\n"
+        "  --frames <dir>      write every shown frame as a pbm into dir\n"
+        "  --every <n>         only write every n-th frame (default 1)\n"
+        "  --seed <n>          value srand() gets at boot (default 1)\n"
+        "  --tail <ms>         keep running this long after the last scripted event (default 5000)\n"
+        "  --max <ms>          stop after this much virtual time\n"
+        "  --i2c-khz <n>       display bus clock, flushes take virtual time (default 400, 0 for none)\n",
+        program);
+}
+
+int main(int argc, char** argv)
+{
+    sim_init();
+    const char* frames = NULL;
+    int every = 1;
+    for(int i = 1; i < argc; i++)
+    {
+        const char* option = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if(!strcmp(option, "--help") || !strcmp(option, "-h"))
+        {
+            sim_usage(argv[0]);
+            return 0;
+        }
+        if(!value)
+        {
+            sim_usage(argv[0]);
+            return 2;
+        }
+        i++;
+
+        if(!strcmp(option, "--script"))
+        {
+            if(!sim_load_script(value))
+                return 1;
+        }
+        else if(!strcmp(option, "--frames"))
+            frames = value;
+        else if(!strcmp(option, "--every"))
+            every = atoi(value);
+        else if(!strcmp(option, "--seed"))
+            sim_set_seed(strtoul(value, NULL, 0));
+        else if(!strcmp(option, "--tail"))
+            sim_set_tail_ms(atoi(value));
+        else if(!strcmp(option, "--max"))
+            sim_set_max_ms(atoi(value));
+        else if(!strcmp(option, "--i2c-khz"))
+            sim_set_i2c_khz(atoi(value));
+        else
+        {
+            sim_usage(argv[0]);
+            return 2;
+        }
+    }
+    sim_set_frame_output(frames, every);
+
+    //never returns, the simulator exits once the script and its tail have played out
+    app_main();
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "globals.h"
+#include "display.h"
+#include "../games/snake.h"
+
+//plays many headless snake games side by side for tuning the autopilot and fuzzing the game
+//logic, every game only touches its own snake_state so the threads share nothing but the
+//neighbour table, run as game_console_snake_games [games] [threads] [autopilot|fuzz]
+#define GAMES_MAX_THREADS  64
+#define GAMES_MAX_TICKS    20000
+
+u8g2_t u8g2;
+u8g2_esp32_hal_t u8g2_esp32_hal = U8G2_ESP32_HAL_DEFAULT;
+int snake_highscore = 0;
+
+typedef struct games_worker
+{
+    pthread_t thread;
+    int first_game, game_count;
+    bool fuzz;
+    snake_state game;
+
+    uint64_t ticks, score, apples;
+    int capped, best_score, broken;
+} games_worker;
+
+static games_worker games_workers[GAMES_MAX_THREADS];
+
+//what must hold after every step, returns the broken rule or NULL
+static const char* games_check(const snake_state* game)
+{
+    if(game->map.free_count != SNAKE_CELLS - game->body.length)
+        return "free cells do not match the body length";
+    snake_segment head = snake_head(&game->body);
+    if(!snake_cell_occupied(&game->map, SNAKE_SEGMENT_X(head), SNAKE_SEGMENT_Y(head)))
+        return "head cell is not occupied";
+    if(game->apple_x != -1 && snake_cell_occupied(&game->map, game->apple_x, game->apple_y))
+        return "apple is on the snake";
+    return NULL;
+}
+
+static void* games_run(void* arg)
+{
+    games_worker* worker = arg;
+    snake_state* game = &worker->game;
+    for(int k = 0; k < worker->game_count; k++)
+    {
+        //the seed is the game number, so a game plays out the same whatever thread runs it
+        unsigned int seed = worker->first_game + k + 1, turn_seed = seed;
+        snake_reset(game, seed, true, false);
+        int tick = 0;
+        for(; tick < GAMES_MAX_TICKS; tick++)
+        {
+            direction turn = worker->fuzz ? (direction)(rand_r(&turn_seed) & 3) :
+                snake_autopilot(game, game->snake_direction);
+            if(!snake_step(game, turn))
+                break;
+            const char* broken = games_check(game);
+            if(broken)
+            {
+                fprintf(stderr, "game %u tick %d: %s\n", seed, tick, broken);
+                worker->broken++;
+                break;
+            }
+        }
+        worker->ticks += tick;
+        worker->score += game->score;
+        worker->apples += game->body.length - 4;
+        worker->capped += tick == GAMES_MAX_TICKS;
+        if(game->score > worker->best_score)
+            worker->best_score = game->score;
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    int games = argc > 1 ? atoi(argv[1]) : 1000;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    bool fuzz = argc > 3 && strcmp(argv[3], "fuzz") == 0;
+    if(games < 1 || threads < 1 || threads > GAMES_MAX_THREADS)
+    {
+        fprintf(stderr, "usage: %s [games] [threads 1-%d] [autopilot|fuzz]\n", argv[0], GAMES_MAX_THREADS);
+        return 2;
+    }
+
+    //the neighbour table and the tile atlas are shared by every game, they are built once before
+    //the threads start
+    snake_neighbors_init();
+    snake_atlas_init();
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < threads; i++)
+    {
+        games_worker* worker = &games_workers[i];
+        worker->first_game = games * i / threads;
+        worker->game_count = games * (i + 1) / threads - worker->first_game;
+        worker->fuzz = fuzz;
+        pthread_create(&worker->thread, NULL, games_run, worker);
+    }
+
+    uint64_t ticks = 0, score = 0, apples = 0;
+    int capped = 0, best_score = 0, broken = 0;
+    for(int i = 0; i < threads; i++)
+    {
+        games_worker* worker = &games_workers[i];
+        pthread_join(worker->thread, NULL);
+        ticks += worker->ticks, score += worker->score, apples += worker->apples;
+        capped += worker->capped, broken += worker->broken;
+        if(worker->best_score > best_score)
+            best_score = worker->best_score;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("snake %s on %dx%d: %d games on %d threads in %.2f s, %.1f games/s, %.0f steps/s\n",
+        fuzz ? "fuzz" : "autopilot", MAP_WIDTH, MAP_HEIGHT, games, threads, seconds, games / seconds, ticks / seconds);
+    printf("per game %.0f ticks, %.1f apples, score %.1f (best %d, total %llu), %d hit the %d tick cap\n",
+        (double)ticks / games, (double)apples / games, (double)score / games, best_score,
+        (unsigned long long)score, capped, GAMES_MAX_TICKS);
+    if(broken)
+        printf("%d games broke an invariant\n", broken);
+    return broken ? 1 : 0;
+}
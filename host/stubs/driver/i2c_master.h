@@ -0,0 +1,4 @@
+#pragma once
+#include "driver/gpio.h"
+
+//the panel traffic goes through u8g2_esp32_i2c_byte_cb, nothing here is called directly
@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+//wall clock scaled to CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ so profiler numbers read like on the chip
+uint32_t esp_cpu_get_cycle_count(void);
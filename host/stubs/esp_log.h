@@ -0,0 +1,15 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+
+//log lines go to stderr so stdout stays free for the profiler and benchmark tables
+#define ESP_LOG_LINE(letter, tag, format, ...) fprintf(stderr, letter " (%lld) %s: " format "\n", \
+    (long long)(esp_timer_get_time() / 1000), tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LINE("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LINE("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LINE("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do {} while(0)
+#define ESP_LOGV(tag, format, ...) do {} while(0)
@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+//busy wait, advances the virtual clock like a delay and plays the button events due meanwhile
+void esp_rom_delay_us(uint32_t us);
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define configTICK_RATE_HZ   CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS   ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY        ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define pdFALSE  0
+#define pdTRUE   1
+#define pdFAIL   pdFALSE
+#define pdPASS   pdTRUE
+#define errQUEUE_FULL  pdFAIL
+
+//critical sections become a mutex, simulated isrs run on the game thread outside of them
+typedef struct
+{
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED  {PTHREAD_MUTEX_INITIALIZER}
+#define portENTER_CRITICAL(mux)       pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)        pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_ISR(mux)   pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL_ISR(mux)    pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_SAFE(mux)  pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL_SAFE(mux)   pthread_mutex_unlock(&(mux)->mutex)
@@ -0,0 +1,17 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define PRO_CPU_NUM     0
+#define APP_CPU_NUM     1
+#define tskNO_AFFINITY  0x7fffffff
+
+//delays advance the virtual clock, tasks are plain threads
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake_time, TickType_t time_increment);
+TickType_t xTaskGetTickCount(void);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack_depth,
+    void* parameters, UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id);
+void vTaskDelete(TaskHandle_t task);
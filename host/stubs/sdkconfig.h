@@ -0,0 +1,5 @@
+#pragma once
+
+//the few sdkconfig values the console reads, matching the esp-idf defaults
+#define CONFIG_FREERTOS_HZ               100
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ  240
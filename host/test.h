@@ -0,0 +1,21 @@
+#pragma once
+#include <stdio.h>
+
+//checks shared by the host tests, a failed check is reported with its line and counted, and the
+//test goes on so one run shows every failure
+static int test_failures = 0;
+
+#define TEST_CHECK(cond) do { if(!(cond)) { \
+    fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); test_failures++; } } while(0)
+
+//prints the outcome under the test's name, main returns it
+static int test_report(const char* name)
+{
+    if(test_failures)
+    {
+        printf("%s: %d checks failed\n", name, test_failures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", name);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "globals.h"
+#include "profiler.h"
+
+//hand finished frames to a flush task on the second core instead of blocking on the bus
+#ifndef DISPLAY_ASYNC_FLUSH
+#define DISPLAY_ASYNC_FLUSH 1
+#endif
+#define DISPLAY_FRAME_BUFFERS     2
+#define DISPLAY_FLUSH_TASK_STACK  4096
+#define DISPLAY_FLUSH_TASK_PRIO   5
+
+#define DISPLAY_PAGES        (DISPLAY_HEIGHT / 8)
+#define DISPLAY_TILES        (DISPLAY_WIDTH / 8)
+#define DISPLAY_BUFFER_SIZE  (DISPLAY_WIDTH * DISPLAY_PAGES)
+
+//framebuffer traffic counters, bytes_sent only counts tile payload (bytes sent with D/C high)
+typedef struct display_flush_stats
+{
+    uint32_t frames;
+    uint32_t transfers;
+    uint32_t tiles_sent;
+    uint32_t bytes_sent;
+} display_flush_stats;
+
+//copy of what the panel currently shows
+static uint8_t display_shadow[DISPLAY_BUFFER_SIZE];
+static volatile bool display_shadow_valid = false;
+static display_flush_stats display_stats;
+
+//finds the next run of changed tiles in a page starting at tile, returns run length (0 if none)
+short int display_next_dirty_run(const uint8_t* frame, const uint8_t* shadow, short int page, short int* tile)
+{
+    const uint8_t* frame_page = frame + page * DISPLAY_WIDTH;
+    const uint8_t* shadow_page = shadow + page * DISPLAY_WIDTH;
+
+    short int first = *tile;
+    while(first < DISPLAY_TILES && !memcmp(frame_page + first * 8, shadow_page + first * 8, 8))
+        first++;
+
+    short int last = first;
+    while(last < DISPLAY_TILES && memcmp(frame_page + last * 8, shadow_page + last * 8, 8))
+        last++;
+
+    *tile = first;
+    return last - first;
+}
+
+void display_flush_frame(uint8_t* frame)
+{
+    for(short int page = 0; page < DISPLAY_PAGES; page++)
+    {
+        short int tile = 0;
+        while(tile < DISPLAY_TILES)
+        {
+            short int count = DISPLAY_TILES - tile;
+            if(display_shadow_valid)
+                count = display_next_dirty_run(frame, display_shadow, page, &tile);
+            if(count == 0)
+                break;
+
+            uint8_t* run = frame + page * DISPLAY_WIDTH + tile * 8;
+            u8x8_DrawTile(&u8g2.u8x8, tile, page, count, run);
+            memcpy(display_shadow + (run - frame), run, count * 8);
+
+            display_stats.transfers++;
+            display_stats.tiles_sent += count;
+            display_stats.bytes_sent += count * 8;
+            tile += count;
+        }
+    }
+    display_shadow_valid = true;
+    display_stats.frames++;
+}
+
+#if DISPLAY_ASYNC_FLUSH
+//frames owned by the game (free) or waiting for / on the bus (ready)
+static uint8_t display_frames[DISPLAY_FRAME_BUFFERS][DISPLAY_BUFFER_SIZE];
+static QueueHandle_t display_free_queue;
+static QueueHandle_t display_ready_queue;
+
+void display_flush_task(void* arg)
+{
+    uint8_t index;
+    while(true)
+    {
+        xQueueReceive(display_ready_queue, &index, portMAX_DELAY);
+        PROFILE_BEGIN(PROFILE_BUS);
+        display_flush_frame(display_frames[index]);
+        PROFILE_END(PROFILE_BUS);
+        xQueueSend(display_free_queue, &index, portMAX_DELAY);
+    }
+}
+#endif
+
+void display_init()
+{
+#if DISPLAY_ASYNC_FLUSH
+    display_free_queue = xQueueCreate(DISPLAY_FRAME_BUFFERS, sizeof(uint8_t));
+    display_ready_queue = xQueueCreate(DISPLAY_FRAME_BUFFERS, sizeof(uint8_t));
+    for(uint8_t i = 0; i < DISPLAY_FRAME_BUFFERS; i++)
+        xQueueSend(display_free_queue, &i, 0);
+
+    xTaskCreatePinnedToCore(display_flush_task, "display_flush", DISPLAY_FLUSH_TASK_STACK,
+        NULL, DISPLAY_FLUSH_TASK_PRIO, NULL, APP_CPU_NUM);
+#endif
+}
+
+//sends only the tiles that changed since the previous flush,
+//in async mode this only waits for a free back buffer and returns
+void display_flush()
+{
+#if DISPLAY_ASYNC_FLUSH
+    uint8_t index;
+    xQueueReceive(display_free_queue, &index, portMAX_DELAY);
+    memcpy(display_frames[index], u8g2_GetBufferPtr(&u8g2), DISPLAY_BUFFER_SIZE);
+    xQueueSend(display_ready_queue, &index, portMAX_DELAY);
+#else
+    display_flush_frame(u8g2_GetBufferPtr(&u8g2));
+#endif
+}
+
+//blocks until every queued frame is on the panel, call before light sleep
+void display_sync()
+{
+#if DISPLAY_ASYNC_FLUSH
+    uint8_t indices[DISPLAY_FRAME_BUFFERS];
+    for(int i = 0; i < DISPLAY_FRAME_BUFFERS; i++)
+        xQueueReceive(display_free_queue, &indices[i], portMAX_DELAY);
+    for(int i = 0; i < DISPLAY_FRAME_BUFFERS; i++)
+        xQueueSend(display_free_queue, &indices[i], 0);
+#endif
+}
+
+//forces the next flush to resend the whole frame (e.g. after the panel lost its contents)
+void display_invalidate()
+{
+    display_shadow_valid = false;
+}
+
+void display_reset_stats()
+{
+    memset(&display_stats, 0, sizeof(display_stats));
+}
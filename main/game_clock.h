@@ -0,0 +1,110 @@
+#pragma once
+#include <stdint.h>
+#include <esp_log.h>
+#include <esp_rom_sys.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+//fixed rate game loop pacing, game logic advances once per tick no matter how long
+//rendering and flushing took as long as a frame fits in its tick
+typedef struct game_clock
+{
+    const char* name;
+    TickType_t period;
+    TickType_t last_wake;
+    int64_t start_us;
+    int64_t tick_start_us;
+    int64_t frame_start_us;
+    int64_t max_frame_us;
+    uint32_t ticks;
+    uint32_t frames;    //ticks plus the extra frames drawn in between them
+    uint32_t overruns;
+    uint32_t dropped;
+} game_clock;
+
+void game_clock_start(game_clock* loop, const char* name, int period_ms)
+{
+    loop->name = name;
+    loop->period = pdMS_TO_TICKS(period_ms);
+    if(loop->period == 0)
+        loop->period = 1;
+    loop->last_wake = xTaskGetTickCount();
+    loop->start_us = esp_timer_get_time();
+    loop->tick_start_us = loop->start_us;
+    loop->frame_start_us = loop->start_us;
+    loop->max_frame_us = 0;
+    loop->ticks = 0;
+    loop->frames = 0;
+    loop->overruns = 0;
+    loop->dropped = 0;
+}
+
+//changes the tick length from the next tick on
+void game_clock_set_period(game_clock* loop, int period_ms)
+{
+    loop->period = pdMS_TO_TICKS(period_ms);
+    if(loop->period == 0)
+        loop->period = 1;
+}
+
+//sleeps until the next tick, a frame that missed its deadline counts as an overrun and
+//whole ticks that were missed are dropped instead of being replayed back to back
+void game_clock_wait(game_clock* loop)
+{
+    int64_t frame_us = esp_timer_get_time() - loop->frame_start_us;
+    if(frame_us > loop->max_frame_us)
+        loop->max_frame_us = frame_us;
+
+    TickType_t now = xTaskGetTickCount();
+    TickType_t behind = now - loop->last_wake;
+    if(behind >= loop->period)
+    {
+        loop->overruns++;
+        uint32_t missed = behind / loop->period - 1;
+        loop->dropped += missed;
+        loop->last_wake += missed * loop->period;
+    }
+    xTaskDelayUntil(&loop->last_wake, loop->period);
+
+    loop->ticks++;
+    loop->frames++;
+    loop->tick_start_us = esp_timer_get_time();
+    loop->frame_start_us = loop->tick_start_us;
+}
+
+//for games that draw several frames per tick: sleeps until step / steps of the current tick have
+//passed, returns false when the next step is already due so that this frame should be skipped,
+//the last step of a tick is never skipped
+bool game_clock_wait_step(game_clock* loop, int step, int steps)
+{
+    int64_t period_us = (int64_t)loop->period * portTICK_PERIOD_MS * 1000;
+    int64_t step_us = loop->tick_start_us + period_us * step / steps;
+    int64_t now_us = esp_timer_get_time();
+    if(now_us - loop->frame_start_us > loop->max_frame_us)
+        loop->max_frame_us = now_us - loop->frame_start_us;
+    if(step + 1 < steps && now_us >= loop->tick_start_us + period_us * (step + 1) / steps)
+        return false;
+    //sleeps the whole rtos ticks that surely end before the step and spins off the rest, a
+    //12.5 ms step would otherwise land on 10 or 20 ms at the default 100 Hz tick
+    int64_t rtos_tick_us = portTICK_PERIOD_MS * 1000;
+    while(step_us - now_us >= rtos_tick_us)
+    {
+        vTaskDelay((step_us - now_us) / rtos_tick_us);
+        now_us = esp_timer_get_time();
+    }
+    if(now_us < step_us)
+        esp_rom_delay_us(step_us - now_us);
+    loop->frames++;
+    loop->frame_start_us = esp_timer_get_time();
+    return true;
+}
+
+void game_clock_report(game_clock* loop)
+{
+    int64_t elapsed_us = esp_timer_get_time() - loop->start_us;
+    ESP_LOGI(loop->name, "%lu ticks, %lu frames (%.1f fps), %lu overruns, %lu dropped, longest frame %lld us",
+        (unsigned long)loop->ticks, (unsigned long)loop->frames,
+        elapsed_us > 0 ? loop->frames * 1e6 / elapsed_us : 0.0, (unsigned long)loop->overruns,
+        (unsigned long)loop->dropped, (long long)loop->max_frame_us);
+}
@@ -1,12 +1,25 @@
 #include "driver/rtc_io.h"
 #include "globals.h"
+#include "display.h"
+#include "input.h"
+#include "game_clock.h"
+#include "highscores.h"
 #include "../games/snake.h"
 #include "../games/tetris.h"
 #include "../games/flappy_bird.h"
 
-typedef enum game_state{
-    SNAKE, TETRIS, FLAPPY_BIRD
-} game_state;
+//everything the console needs to know about a game, adding a game only means adding a row
+typedef struct console_game
+{
+    const char* name;
+    void (*run)();
+    void (*draw_left_frame)();
+    void (*draw_middle_frame)();
+    void (*draw_right_frame)();
+    void (*demo)();         //attract mode played when the menu sits idle, NULL if the game has none
+    int* highscore;
+    size_t state_size;
+} console_game;
 
 u8g2_t u8g2;
 u8g2_esp32_hal_t u8g2_esp32_hal = U8G2_ESP32_HAL_DEFAULT;
@@ -14,6 +27,60 @@ int snake_highscore = 0;
 int tetris_highscore = 0;
 int flappy_bird_highscore = 0;
 
+static const console_game console_games[] =
+{
+    {"Snake", snake_run, snake_draw_left_frame, snake_draw_middle_frame,
+        snake_draw_right_frame, snake_demo, &snake_highscore, sizeof(snake_game) + sizeof(snake_neighbors)},
+    {"Tetris", tetris_run, tetris_draw_left_frame, tetris_draw_middle_frame,
+        tetris_draw_right_frame, NULL, &tetris_highscore,
+        sizeof(tetris_board) + sizeof(tetris_heights) + sizeof(tetris_upcoming)},
+    //flappy bird keeps a round on the stack of its run function, only its random generator is static
+    {"Flappy Bird", flappy_bird_run, flappy_bird_draw_left_frame, flappy_bird_draw_middle_frame,
+        flappy_bird_draw_right_frame, NULL, &flappy_bird_highscore, sizeof(rand_num)},
+};
+
+#define CONSOLE_NUMBER_OF_GAMES (sizeof(console_games) / sizeof(console_games[0]))
+
+static const char* CONSOLE_TAG = "console";
+
+//menu thumbnails are rendered once at boot into page format bitmaps covering the
+//inside of each frame, every menu redraw is then a background copy plus three blits
+typedef enum console_slot_id
+{
+    SLOT_LEFT, SLOT_MIDDLE, SLOT_RIGHT, CONSOLE_SLOTS
+} console_slot_id;
+
+typedef struct console_slot
+{
+    short int x;
+    short int width;
+} console_slot;
+
+#define CONSOLE_THUMBNAIL_PAGE       2
+#define CONSOLE_THUMBNAIL_PAGES      4
+#define CONSOLE_THUMBNAIL_MAX_WIDTH  30
+#define CONSOLE_CLIP_LEFT            23
+#define CONSOLE_CLIP_RIGHT           109
+#define CONSOLE_SLOT_PITCH           33
+#define CONSOLE_SLIDE_FRAMES         6
+#define CONSOLE_SLIDE_MS             20
+#define CONSOLE_ATTRACT_MS           30000
+
+static const console_slot console_slots[CONSOLE_SLOTS] = {{23, 20}, {51, 30}, {89, 20}};
+static uint8_t console_background[DISPLAY_BUFFER_SIZE];
+static uint8_t console_thumbnails[CONSOLE_NUMBER_OF_GAMES][CONSOLE_SLOTS]
+    [CONSOLE_THUMBNAIL_PAGES][CONSOLE_THUMBNAIL_MAX_WIDTH];
+
+short int console_previous_game(short int game)
+{
+    return (game + CONSOLE_NUMBER_OF_GAMES - 1) % CONSOLE_NUMBER_OF_GAMES;
+}
+
+short int console_next_game(short int game)
+{
+    return (game + 1) % CONSOLE_NUMBER_OF_GAMES;
+}
+
 void console_draw_frame()
 {
     //draw left and right arrows
@@ -46,95 +113,183 @@ void console_draw_frame()
     u8g2_DrawStr(&u8g2, (128 - top_text_width) / 2 + 3, DISPLAY_HEIGHT/2 - 20, top_text);
 }
 
-void console_draw_screen(game_state game)
+void console_cache_menu()
 {
-    u8g2_ClearBuffer(&u8g2);
+    uint8_t* buffer = u8g2_GetBufferPtr(&u8g2);
 
+    u8g2_ClearBuffer(&u8g2);
     console_draw_frame();
+    memcpy(console_background, buffer, DISPLAY_BUFFER_SIZE);
+
+    for(size_t game = 0; game < CONSOLE_NUMBER_OF_GAMES; game++)
+    {
+        void (*draw[CONSOLE_SLOTS])() = {console_games[game].draw_left_frame,
+            console_games[game].draw_middle_frame, console_games[game].draw_right_frame};
+        for(short int slot = 0; slot < CONSOLE_SLOTS; slot++)
+        {
+            u8g2_ClearBuffer(&u8g2);
+            draw[slot]();
+            for(short int page = 0; page < CONSOLE_THUMBNAIL_PAGES; page++)
+                memcpy(console_thumbnails[game][slot][page],
+                    buffer + (CONSOLE_THUMBNAIL_PAGE + page) * DISPLAY_WIDTH + console_slots[slot].x,
+                    console_slots[slot].width);
+        }
+    }
+    u8g2_SetDrawColor(&u8g2, 1);
+}
+
+//ors a cached thumbnail into the frame buffer with its left edge at x, clipped to the carousel
+void console_blit_thumbnail(short int game, console_slot_id slot, short int x)
+{
+    uint8_t* buffer = u8g2_GetBufferPtr(&u8g2);
+    for(short int page = 0; page < CONSOLE_THUMBNAIL_PAGES; page++)
+    {
+        uint8_t* row = buffer + (CONSOLE_THUMBNAIL_PAGE + page) * DISPLAY_WIDTH;
+        for(short int col = 0; col < console_slots[slot].width; col++)
+        {
+            short int dst = x + col;
+            if(dst >= CONSOLE_CLIP_LEFT && dst < CONSOLE_CLIP_RIGHT)
+                row[dst] |= console_thumbnails[game][slot][page][col];
+        }
+    }
+}
+
+void console_draw_screen(short int game)
+{
+    memcpy(u8g2_GetBufferPtr(&u8g2), console_background, DISPLAY_BUFFER_SIZE);
+
+    console_blit_thumbnail(console_previous_game(game), SLOT_LEFT, console_slots[SLOT_LEFT].x);
+    console_blit_thumbnail(game, SLOT_MIDDLE, console_slots[SLOT_MIDDLE].x);
+    console_blit_thumbnail(console_next_game(game), SLOT_RIGHT, console_slots[SLOT_RIGHT].x);
 
-    switch (game)
+    display_flush();
+}
+
+//slides the thumbnails one slot to the left (step 1) or right (step -1) from the selected game
+void console_slide(short int game, short int step)
+{
+    game_clock loop;
+    game_clock_start(&loop, "menu", CONSOLE_SLIDE_MS);
+    for(short int frame = 1; frame < CONSOLE_SLIDE_FRAMES; frame++)
+    {
+        memcpy(u8g2_GetBufferPtr(&u8g2), console_background, DISPLAY_BUFFER_SIZE);
+        short int shift = step * CONSOLE_SLOT_PITCH * frame / CONSOLE_SLIDE_FRAMES;
+        for(short int i = -2; i <= 2; i++)
+        {
+            short int shown = (game + i + 2 * CONSOLE_NUMBER_OF_GAMES) % CONSOLE_NUMBER_OF_GAMES;
+            console_slot_id slot = i < 0 ? SLOT_LEFT : (i > 0 ? SLOT_RIGHT : SLOT_MIDDLE);
+            short int center = console_slots[SLOT_MIDDLE].x + console_slots[SLOT_MIDDLE].width / 2
+                + i * CONSOLE_SLOT_PITCH - shift;
+            console_blit_thumbnail(shown, slot, center - console_slots[slot].width / 2);
+        }
+        display_flush();
+        game_clock_wait(&loop);
+    }
+}
+
+//the selected game's attract mode, or the next game that has one
+void console_run_demo(short int game)
+{
+    for(size_t i = 0; i < CONSOLE_NUMBER_OF_GAMES; i++)
     {
-        case SNAKE:
-            flappy_bird_draw_left_frame();
-            snake_draw_middle_frame();
-            tetris_draw_right_frame();
-            break;
-        case TETRIS:
-            snake_draw_left_frame();
-            tetris_draw_middle_frame();
-            flappy_bird_draw_right_frame();
-            break;
-        case FLAPPY_BIRD:
-            tetris_draw_left_frame();
-            flappy_bird_draw_middle_frame();
-            snake_draw_right_frame();
-            break;
+        const console_game* shown = &console_games[(game + i) % CONSOLE_NUMBER_OF_GAMES];
+        if(shown->demo)
+        {
+            ESP_LOGI(CONSOLE_TAG, "attract mode: %s", shown->name);
+            shown->demo();
+            return;
+        }
     }
+}
 
-    u8g2_SendBuffer(&u8g2);
+void console_run_game(short int game)
+{
+    const console_game* chosen = &console_games[game];
+    ESP_LOGI(CONSOLE_TAG, "starting %s, %u bytes of static state", chosen->name, (unsigned)chosen->state_size);
+    chosen->run();
+}
+
+//a button still held would wake the menu straight away
+void console_wait_release()
+{
+    for(short int i = 0; i < INPUT_BUTTON_COUNT; i++)
+        while(input_held(i))
+            vTaskDelay(10 / portTICK_PERIOD_MS);
+}
+
+//presses that queued up while the menu was animating
+uint8_t console_pending_presses()
+{
+    uint8_t buttons = 0;
+    input_event event;
+    while(input_poll(&event))
+        if(event.pressed)
+            buttons |= INPUT_MASK(event.button);
+    return buttons;
 }
 
 void app_main()
 {
     init_buttons();
+    input_init();
     init_display();
+    display_init();
     init_low_power_mode();
     srand(time(0));
+    snake_neighbors_init();
+    snake_atlas_init();
+
+    int* highscores[CONSOLE_NUMBER_OF_GAMES];
+    for(size_t i = 0; i < CONSOLE_NUMBER_OF_GAMES; i++)
+        highscores[i] = console_games[i].highscore;
+    highscores_init(highscores, CONSOLE_NUMBER_OF_GAMES);
 
-    game_state selected_game = SNAKE;
-    game_state previous_game = SNAKE;
+    console_cache_menu();
+
+    short int selected_game = 0;
+    short int previous_game = 0;
 
     while(true)
     {
         console_draw_screen(selected_game);
 
-        esp_light_sleep_start();
-
-        if(gpio_get_level(LEFT_BUTTON))
-            switch(selected_game)
-            {
-                case SNAKE:
-                    selected_game = FLAPPY_BIRD; break;
-                case TETRIS:
-                    selected_game = SNAKE; break;
-                case FLAPPY_BIRD:
-                    selected_game = TETRIS; break;
-            }
-
-        if(gpio_get_level(RIGHT_BUTTON))
-            switch(selected_game)
-            {
-                case SNAKE:
-                    selected_game = TETRIS; break;
-                case TETRIS:
-                    selected_game = FLAPPY_BIRD; break;
-                case FLAPPY_BIRD:
-                    selected_game = SNAKE; break;
-            }
-
-        if(gpio_get_level(UP_BUTTON))
-            switch(previous_game)
-            {
-                case SNAKE:
-                    snake_run(); break;
-                case TETRIS:
-                    tetris_run(); break;
-                case FLAPPY_BIRD:
-                    flappy_bird_run(); break;
-            }
-
-        if(gpio_get_level(DOWN_BUTTON))
+        uint8_t buttons = console_pending_presses();
+        if(!buttons)
+            buttons = input_sleep_until_press_or_timeout(CONSOLE_ATTRACT_MS) | console_pending_presses();
+
+        //nobody touched the console for a while, play a game by itself until a button is pressed,
+        //that press only brings the menu back
+        if(!buttons)
+        {
+            console_run_demo(selected_game);
+            console_wait_release();
+            input_flush();
+            continue;
+        }
+
+        if(buttons & INPUT_MASK(INPUT_LEFT))
+        {
+            console_slide(selected_game, -1);
+            selected_game = console_previous_game(selected_game);
+        }
+
+        if(buttons & INPUT_MASK(INPUT_RIGHT))
+        {
+            console_slide(selected_game, 1);
+            selected_game = console_next_game(selected_game);
+        }
+
+        if(buttons & INPUT_MASK(INPUT_UP))
+        {
+            console_run_game(previous_game);
+            input_flush();
+        }
+
+        if(buttons & INPUT_MASK(INPUT_DOWN))
         {
-            switch(selected_game)
-            {
-                case SNAKE:
-                    snake_run(); break;
-                case TETRIS:
-                    tetris_run(); break;
-                case FLAPPY_BIRD:
-                    flappy_bird_run(); break;
-            }
+            console_run_game(selected_game);
             previous_game = selected_game;
+            input_flush();
         }
     }
 }
@@ -0,0 +1,109 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <esp_crc.h>
+#include <esp_log.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+
+#define HIGHSCORES_NAMESPACE  "console"
+#define HIGHSCORES_KEY        "highscores"
+#define HIGHSCORES_VERSION    1
+#define HIGHSCORES_SLOTS      8   //slot i belongs to game i of the console registry, append new games at the end
+
+//layout of the blob stored in nvs, bump HIGHSCORES_VERSION when it changes
+typedef struct highscores_record
+{
+    uint16_t version;
+    uint16_t count;
+    int32_t scores[HIGHSCORES_SLOTS];
+    uint32_t crc;
+} highscores_record;
+
+static const char* HIGHSCORES_TAG = "highscores";
+static int* highscores_slots[HIGHSCORES_SLOTS];
+static short int highscores_count = 0;
+static highscores_record highscores_saved;
+static nvs_handle_t highscores_handle;
+static bool highscores_ready = false;
+
+uint32_t highscores_crc(const highscores_record* record)
+{
+    return esp_crc32_le(0, (const uint8_t*)record, offsetof(highscores_record, crc));
+}
+
+//opens nvs and loads the stored records into the given highscore variables
+void highscores_init(int** slots, short int count)
+{
+    if(count > HIGHSCORES_SLOTS)
+        count = HIGHSCORES_SLOTS;
+    highscores_count = count;
+    memcpy(highscores_slots, slots, count * sizeof(slots[0]));
+
+    memset(&highscores_saved, 0, sizeof(highscores_saved));
+    highscores_saved.version = HIGHSCORES_VERSION;
+    highscores_saved.count = count;
+    for(short int i = 0; i < count; i++)
+        highscores_saved.scores[i] = *slots[i];
+
+    esp_err_t err = nvs_flash_init();
+    if(err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    if(err == ESP_OK)
+        err = nvs_open(HIGHSCORES_NAMESPACE, NVS_READWRITE, &highscores_handle);
+    if(err != ESP_OK)
+    {
+        ESP_LOGW(HIGHSCORES_TAG, "nvs unavailable (%d), highscores will not persist", err);
+        return;
+    }
+    highscores_ready = true;
+
+    highscores_record record;
+    size_t size = sizeof(record);
+    err = nvs_get_blob(highscores_handle, HIGHSCORES_KEY, &record, &size);
+    if(err != ESP_OK)
+        return;
+    if(size != sizeof(record) || record.version != HIGHSCORES_VERSION || record.crc != highscores_crc(&record))
+    {
+        ESP_LOGW(HIGHSCORES_TAG, "discarding invalid highscore record");
+        return;
+    }
+
+    for(short int i = 0; i < count && i < record.count; i++)
+    {
+        *slots[i] = record.scores[i];
+        highscores_saved.scores[i] = record.scores[i];
+    }
+}
+
+//writes the highscores back only if one of them was beaten since the last write,
+//call it once a game is over, never from a game loop
+void highscores_commit()
+{
+    if(!highscores_ready)
+        return;
+
+    bool changed = false;
+    for(short int i = 0; i < highscores_count; i++)
+    {
+        if(*highscores_slots[i] != highscores_saved.scores[i])
+        {
+            highscores_saved.scores[i] = *highscores_slots[i];
+            changed = true;
+        }
+    }
+    if(!changed)
+        return;
+
+    highscores_saved.crc = highscores_crc(&highscores_saved);
+    esp_err_t err = nvs_set_blob(highscores_handle, HIGHSCORES_KEY, &highscores_saved, sizeof(highscores_saved));
+    if(err == ESP_OK)
+        err = nvs_commit(highscores_handle);
+    if(err != ESP_OK)
+        ESP_LOGW(HIGHSCORES_TAG, "failed to save highscores (%d)", err);
+}
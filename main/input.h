@@ -0,0 +1,192 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <driver/gpio.h>
+#include <esp_attr.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include "globals.h"
+#include "display.h"
+
+#define INPUT_DEBOUNCE_US  8000
+#define INPUT_QUEUE_SIZE   16   //must be a power of two
+
+//same order as the snake directions
+typedef enum input_button
+{
+    INPUT_LEFT, INPUT_DOWN, INPUT_RIGHT, INPUT_UP, INPUT_BUTTON_COUNT
+} input_button;
+
+#define INPUT_MASK(button) (1 << (button))
+
+typedef struct input_event
+{
+    int64_t time_us;
+    uint8_t button;
+    bool pressed;
+} input_event;
+
+//per button debounce state, an edge is accepted only if it changes the debounced
+//level and comes at least INPUT_DEBOUNCE_US after the previous accepted edge
+typedef struct input_debouncer
+{
+    int64_t last_edge_us[INPUT_BUTTON_COUNT];
+    uint8_t state;
+} input_debouncer;
+
+static const int input_pins[INPUT_BUTTON_COUNT] = {LEFT_BUTTON, DOWN_BUTTON, RIGHT_BUTTON, UP_BUTTON};
+
+//single consumer ring buffer, the head is only advanced by producers holding input_lock
+//and the tail only by the game task, so draining never blocks the isr. there are two
+//producers, the gpio isr and the wake path of the game task, and both also update the
+//debounce state, so they share a lock instead of the ring being a pure spsc queue
+static input_event input_queue[INPUT_QUEUE_SIZE];
+static volatile uint32_t input_queue_head = 0;
+static volatile uint32_t input_queue_tail = 0;
+static volatile uint32_t input_dropped = 0;
+static input_debouncer input_filter;
+static portMUX_TYPE input_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t input_settle_timers[INPUT_BUTTON_COUNT];
+
+//everything the isr runs is in iram, so an edge is never held up by a flash or nvs write
+bool IRAM_ATTR input_debounce_edge(input_debouncer* filter, uint8_t button, bool level, int64_t now_us, input_event* event)
+{
+    bool pressed = filter->state & INPUT_MASK(button);
+    if(level == pressed)
+        return false;
+    if(filter->last_edge_us[button] != 0 && now_us - filter->last_edge_us[button] < INPUT_DEBOUNCE_US)
+        return false;
+
+    filter->last_edge_us[button] = now_us;
+    filter->state ^= INPUT_MASK(button);
+    event->time_us = now_us;
+    event->button = button;
+    event->pressed = level;
+    return true;
+}
+
+void IRAM_ATTR input_push(const input_event* event)
+{
+    uint32_t head = input_queue_head;
+    if(head - input_queue_tail >= INPUT_QUEUE_SIZE)
+    {
+        input_dropped++;
+        return;
+    }
+    input_queue[head & (INPUT_QUEUE_SIZE - 1)] = *event;
+    input_queue_head = head + 1;
+}
+
+//reads a button and feeds its level through the debounce. an edge that came inside the window of
+//the previous one is rejected, so the level is read again once the window ends, otherwise a
+//release that bounced within 8 ms of its press would leave the button held until the next edge
+static void IRAM_ATTR input_sample(uint8_t button)
+{
+    bool level = gpio_get_level(input_pins[button]);
+    int64_t now_us = esp_timer_get_time();
+    int64_t settle_us = 0;
+    input_event event;
+    portENTER_CRITICAL_SAFE(&input_lock);
+    if(input_debounce_edge(&input_filter, button, level, now_us, &event))
+        input_push(&event);
+    else if(level != (bool)(input_filter.state & INPUT_MASK(button)))
+        settle_us = input_filter.last_edge_us[button] + INPUT_DEBOUNCE_US - now_us;
+    portEXIT_CRITICAL_SAFE(&input_lock);
+    //fails while the timer is still armed, it fires by the end of this window at the latest and
+    //then arms itself again if the window is not over
+    if(settle_us > 0)
+        esp_timer_start_once(input_settle_timers[button], settle_us);
+}
+
+static void IRAM_ATTR input_isr(void* arg)
+{
+    input_sample((uint8_t)(uintptr_t)arg);
+}
+
+static void input_settle(void* arg)
+{
+    input_sample((uint8_t)(uintptr_t)arg);
+}
+
+void input_init()
+{
+    gpio_install_isr_service(0);
+    for(int i = 0; i < INPUT_BUTTON_COUNT; i++)
+    {
+        esp_timer_create_args_t settle = {
+            .callback = input_settle, .arg = (void*)(uintptr_t)i, .name = "input_settle"};
+        esp_timer_create(&settle, &input_settle_timers[i]);
+        gpio_set_intr_type(input_pins[i], GPIO_INTR_ANYEDGE);
+        gpio_isr_handler_add(input_pins[i], input_isr, (void*)(uintptr_t)i);
+    }
+}
+
+//pops the oldest button edge, returns false when the queue is empty
+bool input_poll(input_event* event)
+{
+    uint32_t tail = input_queue_tail;
+    if(tail == input_queue_head)
+        return false;
+    *event = input_queue[tail & (INPUT_QUEUE_SIZE - 1)];
+    input_queue_tail = tail + 1;
+    return true;
+}
+
+void input_flush()
+{
+    input_queue_tail = input_queue_head;
+}
+
+//debounced level of a button
+bool input_held(input_button button)
+{
+    return input_filter.state & INPUT_MASK(button);
+}
+
+//light sleeps until a button wakes the chip and returns the mask of buttons that did, or 0 when
+//timeout_ms (if not 0) ran out first, the wake press is queued as an event since its edge
+//happened while the cpu was stopped
+uint8_t input_sleep_until_press_or_timeout(uint32_t timeout_ms)
+{
+    display_sync();
+    input_flush();
+    if(timeout_ms)
+        esp_sleep_enable_timer_wakeup((uint64_t)timeout_ms * 1000);
+    esp_light_sleep_start();
+    if(timeout_ms)
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+
+    uint64_t wakeup_pins = esp_sleep_get_ext1_wakeup_status();
+    int64_t now_us = esp_timer_get_time();
+    uint8_t buttons = 0;
+    for(int i = 0; i < INPUT_BUTTON_COUNT; i++)
+    {
+        bool woke = wakeup_pins & (1ULL << input_pins[i]);
+        bool level = gpio_get_level(input_pins[i]);
+        if(!woke && !level)
+            continue;
+        buttons |= INPUT_MASK(i);
+
+        input_event event;
+        portENTER_CRITICAL(&input_lock);
+        if(input_debounce_edge(&input_filter, i, true, now_us, &event))
+            input_push(&event);
+        //a tap that was already released again before we got here
+        if(!level && (input_filter.state & INPUT_MASK(i)))
+        {
+            input_filter.state &= ~INPUT_MASK(i);
+            event.time_us = now_us;
+            event.button = i;
+            event.pressed = false;
+            input_push(&event);
+        }
+        portEXIT_CRITICAL(&input_lock);
+    }
+    return buttons;
+}
+
+uint8_t input_sleep_until_press()
+{
+    return input_sleep_until_press_or_timeout(0);
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+//per phase frame profiler, build with PROFILER_ENABLED 1 to get cycle histograms over uart
+//and an fps overlay toggled by holding LEFT and RIGHT together, otherwise every marker is empty
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 0
+#endif
+
+typedef enum profiler_phase
+{
+    PROFILE_INPUT, PROFILE_UPDATE, PROFILE_DRAW, PROFILE_FLUSH, PROFILE_BUS, PROFILER_PHASES
+} profiler_phase;
+
+#if PROFILER_ENABLED
+#include <stdio.h>
+#include <string.h>
+#include <esp_cpu.h>
+#include <esp_timer.h>
+#include "globals.h"
+
+#ifndef CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 240
+#endif
+
+//log2 buckets split into 4 linear steps each, good enough for a p99 within 25%
+#define PROFILER_SUB_BUCKETS  4
+#define PROFILER_BUCKETS      (32 * PROFILER_SUB_BUCKETS)
+
+typedef struct profiler_histogram
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t buckets[PROFILER_BUCKETS];
+} profiler_histogram;
+
+static const char* profiler_phase_names[PROFILER_PHASES] = {"input", "update", "draw", "flush", "bus"};
+static profiler_histogram profiler_histograms[PROFILER_PHASES];
+static uint32_t profiler_started[PROFILER_PHASES];
+static bool profiler_overlay = false;
+static bool profiler_chord = false;
+static int64_t profiler_last_frame_us = 0;
+static uint32_t profiler_frame_us = 0;
+
+short int profiler_bucket(uint32_t cycles)
+{
+    if(cycles < PROFILER_SUB_BUCKETS)
+        return cycles;
+    short int octave = 31 - __builtin_clz(cycles);
+    short int step = (cycles >> (octave - 2)) & (PROFILER_SUB_BUCKETS - 1);
+    return (octave - 1) * PROFILER_SUB_BUCKETS + step;
+}
+
+//smallest cycle count that falls into a bucket
+uint32_t profiler_bucket_floor(short int bucket)
+{
+    if(bucket < PROFILER_SUB_BUCKETS)
+        return bucket;
+    short int octave = bucket / PROFILER_SUB_BUCKETS + 1;
+    short int step = bucket % PROFILER_SUB_BUCKETS;
+    return (uint32_t)(PROFILER_SUB_BUCKETS + step) << (octave - 2);
+}
+
+void profiler_begin(profiler_phase phase)
+{
+    profiler_started[phase] = esp_cpu_get_cycle_count();
+}
+
+void profiler_end(profiler_phase phase)
+{
+    uint32_t cycles = esp_cpu_get_cycle_count() - profiler_started[phase];
+    profiler_histogram* histogram = &profiler_histograms[phase];
+    if(histogram->count == 0 || cycles < histogram->min)
+        histogram->min = cycles;
+    if(cycles > histogram->max)
+        histogram->max = cycles;
+    histogram->count++;
+    histogram->total += cycles;
+    histogram->buckets[profiler_bucket(cycles)]++;
+}
+
+uint32_t profiler_percentile(const profiler_histogram* histogram, short int percent)
+{
+    uint32_t target = (uint64_t)histogram->count * percent / 100;
+    uint32_t seen = 0;
+    for(short int bucket = 0; bucket < PROFILER_BUCKETS; bucket++)
+    {
+        seen += histogram->buckets[bucket];
+        if(seen > target)
+            return profiler_bucket_floor(bucket);
+    }
+    return histogram->max;
+}
+
+void profiler_dump()
+{
+    printf("phase      count     min us     avg us     p99 us     max us\n");
+    for(short int phase = 0; phase < PROFILER_PHASES; phase++)
+    {
+        const profiler_histogram* histogram = &profiler_histograms[phase];
+        if(histogram->count == 0)
+            continue;
+        printf("%-8s %7lu %10.1f %10.1f %10.1f %10.1f\n", profiler_phase_names[phase],
+            (unsigned long)histogram->count,
+            (double)histogram->min / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+            (double)histogram->total / histogram->count / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+            (double)profiler_percentile(histogram, 99) / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+            (double)histogram->max / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    }
+}
+
+void profiler_reset()
+{
+    memset(profiler_histograms, 0, sizeof(profiler_histograms));
+}
+
+//call once per frame right before the flush, chord is true while the toggle buttons are held
+void profiler_frame(bool chord)
+{
+    int64_t now_us = esp_timer_get_time();
+    if(profiler_last_frame_us != 0)
+        profiler_frame_us = now_us - profiler_last_frame_us;
+    profiler_last_frame_us = now_us;
+
+    if(chord && !profiler_chord)
+    {
+        profiler_overlay = !profiler_overlay;
+        profiler_dump();
+    }
+    profiler_chord = chord;
+
+    if(!profiler_overlay || profiler_frame_us == 0)
+        return;
+
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%lufps %lums", (unsigned long)(1000000 / profiler_frame_us),
+        (unsigned long)(profiler_frame_us / 1000));
+    const uint8_t* font = u8g2.font;
+    u8g2_SetFont(&u8g2, u8g2_font_4x6_tf);
+    u8g2_SetDrawColor(&u8g2, 0);
+    u8g2_DrawBox(&u8g2, 0, 0, u8g2_GetStrWidth(&u8g2, buf) + 1, 7);
+    u8g2_SetDrawColor(&u8g2, 1);
+    u8g2_DrawStr(&u8g2, 0, 6, buf);
+    u8g2_SetFont(&u8g2, font);
+}
+
+#define PROFILE_BEGIN(phase) profiler_begin(phase)
+#define PROFILE_END(phase)   profiler_end(phase)
+#define PROFILE_FRAME()      profiler_frame(input_held(INPUT_LEFT) && input_held(INPUT_RIGHT))
+#define PROFILE_DUMP()       profiler_dump()
+#else
+#define PROFILE_BEGIN(phase) do {} while(0)
+#define PROFILE_END(phase)   do {} while(0)
+#define PROFILE_FRAME()      do {} while(0)
+#define PROFILE_DUMP()       do {} while(0)
+#endif